@@ -0,0 +1,257 @@
+#include "clustering.hpp"
+#include "quadric.hpp"
+#include "parallel.hpp"
+#include "validation.hpp"
+
+#include <algorithm>
+#include <stdint.h>
+
+namespace
+{
+  // Vertices or triangles per parallel range
+  const int minRange = 4096;
+
+  // Vertices per block of the bounding box reduction
+  const int blockRows = 65536;
+
+  // Exclusive prefix sum in place, by fixed blocks: block totals in parallel, block offsets
+  // serially, then the sums within every block in parallel. Returns the total.
+  int exclusiveScan(std::vector<int> &values)
+  {
+    int n = values.size();
+    int nBlocks = (n + blockRows - 1) / blockRows;
+    std::vector<int> blockOffsets(nBlocks + 1, 0);
+    parallelFor(nBlocks, 1, [&](int first, int last)
+    {
+      for (int b = first; b < last; ++b)
+      {
+        for (int i = b * blockRows; i < std::min(n, (b + 1) * blockRows); ++i)
+        {
+          blockOffsets[b + 1] += values[i];
+        }
+      }
+    });
+    for (int b = 0; b < nBlocks; ++b)
+    {
+      blockOffsets[b + 1] += blockOffsets[b];
+    }
+    parallelFor(nBlocks, 1, [&](int first, int last)
+    {
+      for (int b = first; b < last; ++b)
+      {
+        int sum = blockOffsets[b];
+        for (int i = b * blockRows; i < std::min(n, (b + 1) * blockRows); ++i)
+        {
+          int value = values[i];
+          values[i] = sum;
+          sum += value;
+        }
+      }
+    });
+    return blockOffsets[nBlocks];
+  }
+}
+
+void clusterVertices(int nVertices, const glm::vec3 *positions, int nTriangles, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency, int resolution, std::vector<glm::vec3> &clusterPositions, std::vector<glm::ivec3> &clusterTriangles)
+{
+  clusterPositions.clear();
+  clusterTriangles.clear();
+  if (nVertices <= 0)
+  {
+    return;
+  }
+  resolution = std::max(1, std::min(resolution, 1 << 21));
+
+  // Bounding box, min and max do not depend on how the blocks are combined
+  int nBlocks = (nVertices + blockRows - 1) / blockRows;
+  std::vector<glm::vec3> blockLow(nBlocks), blockHigh(nBlocks);
+  parallelFor(nBlocks, 1, [&](int first, int last)
+  {
+    for (int b = first; b < last; ++b)
+    {
+      glm::vec3 low = positions[b * blockRows], high = low;
+      for (int v = b * blockRows; v < std::min(nVertices, (b + 1) * blockRows); ++v)
+      {
+        for (int a = 0; a < 3; ++a)
+        {
+          low[a] = std::min(low[a], positions[v][a]);
+          high[a] = std::max(high[a], positions[v][a]);
+        }
+      }
+      blockLow[b] = low;
+      blockHigh[b] = high;
+    }
+  });
+  glm::vec3 low = blockLow[0], high = blockHigh[0];
+  for (int b = 1; b < nBlocks; ++b)
+  {
+    for (int a = 0; a < 3; ++a)
+    {
+      low[a] = std::min(low[a], blockLow[b][a]);
+      high[a] = std::max(high[a], blockHigh[b][a]);
+    }
+  }
+  float extent = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z));
+  float cellSize = extent > 0.0f ? extent / resolution : 1.0f;
+
+  // Cell of every vertex, 21 bits per axis
+  std::vector<uint64_t> cells(nVertices);
+  parallelFor(nVertices, minRange, [&](int begin, int end)
+  {
+    for (int v = begin; v < end; ++v)
+    {
+      uint64_t key = 0;
+      for (int a = 2; a >= 0; --a)
+      {
+        int i = (int)((positions[v][a] - low[a]) / cellSize);
+        key = (key << 21) | (uint64_t)std::max(0, std::min(resolution - 1, i));
+      }
+      cells[v] = key;
+    }
+  });
+
+  // Vertices sorted by cell, so every cell is a run of its vertices in increasing order
+  std::vector<uint64_t> sortedCells(cells);
+  std::vector<int> members(nVertices);
+  parallelFor(nVertices, minRange, [&](int begin, int end)
+  {
+    for (int v = begin; v < end; ++v)
+    {
+      members[v] = v;
+    }
+  });
+  radixSortByKey(sortedCells, members);
+
+  // Clusters are numbered in the order of their first vertex: flag the first vertex of every
+  // run and number the flags in vertex order
+  std::vector<int> firstIds(nVertices, 0);
+  parallelFor(nBlocks, 1, [&](int first, int last)
+  {
+    for (int b = first; b < last; ++b)
+    {
+      for (int i = b * blockRows; i < std::min(nVertices, (b + 1) * blockRows); ++i)
+      {
+        if (i == 0 || sortedCells[i] != sortedCells[i - 1])
+        {
+          firstIds[members[i]] = 1;
+        }
+      }
+    }
+  });
+  int nClusters = exclusiveScan(firstIds);
+
+  // Every run is labelled by the block it starts in
+  std::vector<int> clusterOf(nVertices);
+  std::vector<int> memberBegin(nClusters), memberEnd(nClusters);
+  parallelFor(nBlocks, 1, [&](int first, int last)
+  {
+    for (int b = first; b < last; ++b)
+    {
+      for (int i = b * blockRows; i < std::min(nVertices, (b + 1) * blockRows); ++i)
+      {
+        if (i > 0 && sortedCells[i] == sortedCells[i - 1])
+        {
+          continue;
+        }
+        int c = firstIds[members[i]];
+        int j = i;
+        while (j < nVertices && sortedCells[j] == sortedCells[i])
+        {
+          clusterOf[members[j++]] = c;
+        }
+        memberBegin[c] = i;
+        memberEnd[c] = j;
+      }
+    }
+  });
+
+  // Plane of every face as (unit normal, offset) and its area, computed once for its three corners
+  std::vector<glm::vec4> planes(nTriangles);
+  std::vector<float> areas(nTriangles);
+  parallelFor(nTriangles, minRange, [&](int begin, int end)
+  {
+    for (int f = begin; f < end; ++f)
+    {
+      const int *t = triangles + 3 * f;
+      glm::vec3 normal = glm::cross(positions[t[1]] - positions[t[0]], positions[t[2]] - positions[t[0]]);
+      float length = glm::length(normal);
+      normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+      planes[f] = glm::vec4(normal, -glm::dot(normal, positions[t[0]]));
+      areas[f] = 0.5f * length;
+    }
+  });
+
+  // Representative point of every cluster from the quadrics of the faces around its vertices
+  clusterPositions.resize(nClusters);
+  parallelFor(nClusters, minRange, [&](int begin, int end)
+  {
+    for (int c = begin; c < end; ++c)
+    {
+      Quadric q;
+      glm::vec3 sum(0.0f);
+      for (int k = memberBegin[c]; k < memberEnd[c]; ++k)
+      {
+        int v = members[k];
+        sum += positions[v];
+        for (int j = adjacencyBegin[v]; j < adjacencyEnd[v]; ++j)
+        {
+          const glm::vec4 &plane = planes[adjacency[j]];
+          q.addPlane(glm::vec3(plane.x, plane.y, plane.z), plane.w, areas[adjacency[j]]);
+        }
+      }
+      glm::vec3 mean = sum / (float)(memberEnd[c] - memberBegin[c]);
+
+      // The cell of the cluster, from the key of its first vertex
+      uint64_t key = sortedCells[memberBegin[c]];
+      glm::vec3 cellLow;
+      for (int a = 0; a < 3; ++a)
+      {
+        cellLow[a] = low[a] + cellSize * (float)((key >> (21 * a)) & ((1u << 21) - 1));
+      }
+      glm::vec3 p;
+      bool inside = q.minimizer(p);
+      for (int a = 0; a < 3 && inside; ++a)
+      {
+        inside = p[a] >= cellLow[a] && p[a] <= cellLow[a] + cellSize;
+      }
+      clusterPositions[c] = inside ? p : mean;
+    }
+  });
+
+  // Triangles with three distinct clusters survive, the others become tombstones with three
+  // equal corners that the duplicate search skips
+  std::vector<glm::ivec3> mapped(nTriangles);
+  std::vector<int> keep(nTriangles);
+  parallelFor(nTriangles, minRange, [&](int begin, int end)
+  {
+    for (int t = begin; t < end; ++t)
+    {
+      mapped[t] = glm::ivec3(clusterOf[triangles[3 * t]], clusterOf[triangles[3 * t + 1]], clusterOf[triangles[3 * t + 2]]);
+      keep[t] = mapped[t].x != mapped[t].y && mapped[t].y != mapped[t].z && mapped[t].x != mapped[t].z;
+      if (!keep[t])
+      {
+        mapped[t] = glm::ivec3(mapped[t].x);
+      }
+    }
+  });
+
+  // Keep the first of the triangles on the same three clusters, whatever their orientation
+  std::vector<int> duplicates;
+  findDuplicateTriangles(nTriangles, reinterpret_cast<const Triangle *>(mapped.data()), false, duplicates);
+  for (size_t i = 0; i < duplicates.size(); ++i)
+  {
+    keep[duplicates[i]] = 0;
+  }
+  std::vector<int> slots(keep);
+  clusterTriangles.resize(exclusiveScan(slots));
+  parallelFor(nTriangles, minRange, [&](int begin, int end)
+  {
+    for (int t = begin; t < end; ++t)
+    {
+      if (keep[t])
+      {
+        clusterTriangles[slots[t]] = mapped[t];
+      }
+    }
+  });
+}
@@ -0,0 +1,19 @@
+#ifndef CLUSTERING_HPP
+#define CLUSTERING_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Vertex clustering simplification for quick levels of detail. Positions are quantized to a
+// uniform grid with resolution cells along the longest side of the bounding box, all vertices
+// of a cell merge into one, and triangles with two corners in the same cell disappear (as do
+// copies of a remaining triangle). The merged vertex minimizes the sum of the area-weighted
+// plane quadrics of the faces around the vertices of its cell; where that point is not unique
+// or leaves the cell, the mean of the vertices is used. Runs in linear time, every step as a
+// parallel pass: vertices are grouped by cell and triangles by cluster triple with radix sorts.
+// triangles holds 3 vertex indices per triangle. The triangles around vertex i are
+// adjacency[adjacencyBegin[i]] .. adjacency[adjacencyEnd[i]-1], as for computeVertexNormals.
+// Cells are numbered in the order of their first vertex, and triangles stay in input order.
+void clusterVertices(int nVertices, const glm::vec3 *positions, int nTriangles, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency, int resolution, std::vector<glm::vec3> &clusterPositions, std::vector<glm::ivec3> &clusterTriangles);
+
+#endif // CLUSTERING_HPP
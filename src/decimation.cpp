@@ -0,0 +1,466 @@
+#include "decimation.hpp"
+#include "quadric.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+  // Vertices per parallel range
+  const int minRange = 4096;
+
+  // Weight of the planes that keep boundary edges in place, relative to the triangle planes
+  const double boundaryWeight = 1000.0;
+
+  // Cheapest allowed collapse of a vertex
+  struct Candidate
+  {
+    double cost;
+    int target; // vertex merged into this one, -1 if no edge of the vertex can be collapsed
+    glm::vec3 position;
+  };
+
+  // Binary min-heap of vertices keyed by the cost of their candidate, with the heap slot of
+  // every vertex so a changed key is moved in O(log n). The costs are stored in the heap itself,
+  // so sifting does not touch the candidates. Equal costs are ordered by vertex.
+  class VertexHeap
+  {
+  public:
+    explicit VertexHeap(int nVertices) : slots(nVertices, -1) {}
+
+    bool empty() const { return heap.empty(); }
+    int top() const { return heap[0].vertex; }
+
+    // Insert v with the given cost, or move it to the place of its new cost
+    void update(int v, double cost)
+    {
+      if (slots[v] < 0)
+      {
+        slots[v] = heap.size();
+        heap.push_back(Entry());
+      }
+      Entry entry = {cost, v};
+      int i = slots[v];
+      if (i > 0 && less(entry, heap[(i - 1) / 2]))
+      {
+        siftUp(i, entry);
+      }
+      else
+      {
+        siftDown(i, entry);
+      }
+    }
+
+    void remove(int v)
+    {
+      int i = slots[v];
+      if (i < 0)
+      {
+        return;
+      }
+      slots[v] = -1;
+      Entry last = heap.back();
+      heap.pop_back();
+      if (last.vertex != v)
+      {
+        if (i > 0 && less(last, heap[(i - 1) / 2]))
+        {
+          siftUp(i, last);
+        }
+        else
+        {
+          siftDown(i, last);
+        }
+      }
+    }
+
+  private:
+    struct Entry
+    {
+      double cost;
+      int vertex;
+    };
+
+    std::vector<Entry> heap;
+    std::vector<int> slots;
+
+    static bool less(const Entry &a, const Entry &b)
+    {
+      return a.cost < b.cost || (a.cost == b.cost && a.vertex < b.vertex);
+    }
+
+    void place(int i, const Entry &entry)
+    {
+      heap[i] = entry;
+      slots[entry.vertex] = i;
+    }
+
+    // Move entry up from the free slot i
+    void siftUp(int i, const Entry &entry)
+    {
+      while (i > 0 && less(entry, heap[(i - 1) / 2]))
+      {
+        place(i, heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+      }
+      place(i, entry);
+    }
+
+    // Move entry down from the free slot i
+    void siftDown(int i, const Entry &entry)
+    {
+      int n = heap.size();
+      while (2 * i + 1 < n)
+      {
+        int child = 2 * i + 1;
+        if (child + 1 < n && less(heap[child + 1], heap[child]))
+        {
+          ++child;
+        }
+        if (!less(heap[child], entry))
+        {
+          break;
+        }
+        place(i, heap[child]);
+        i = child;
+      }
+      place(i, entry);
+    }
+  };
+
+  bool hasCorner(const Triangle &triangle, int v)
+  {
+    return triangle.vertices[0] == v || triangle.vertices[1] == v || triangle.vertices[2] == v;
+  }
+
+  // Buffers reused by the evaluation of many vertices, one set per thread
+  struct Scratch
+  {
+    std::vector<Candidate> options;
+    std::vector<int> ring;
+    std::vector<int> ringA;
+    std::vector<int> ringB;
+  };
+
+  // Collapses edges in cost order. A candidate is exact as long as neither of its vertices
+  // changed, and every collapse re-evaluates the remaining vertex and the neighbors that pointed
+  // at it. Whether a collapse is allowed also depends on the neighbors of the neighbors, so that
+  // part is checked again when the candidate reaches the top of the heap (lazy invalidation).
+  class QuadricDecimator
+  {
+  public:
+    explicit QuadricDecimator(Mesh &mesh) : mesh(mesh), quadrics(mesh.numVertices()), boundary(mesh.numVertices()), candidates(mesh.numVertices()), heap(mesh.numVertices()) {}
+
+    DecimationResult run(int targetTriangles, float maxError)
+    {
+      DecimationResult result = {0, 0, 0.0f};
+      int n = mesh.numVertices();
+      for (int t = 0; t < mesh.numTriangles(); ++t)
+      {
+        result.triangles += !mesh.isDeletedTriangle(t);
+      }
+
+      parallelFor(n, minRange, [&](int begin, int end)
+      {
+        Scratch local;
+        for (int v = begin; v < end; ++v)
+        {
+          quadrics[v] = vertexQuadric(v);
+          oneRing(v, local.ring);
+          boundary[v] = 0;
+          for (int u : local.ring)
+          {
+            boundary[v] |= edgeTriangleCount(v, u) == 1;
+          }
+        }
+      });
+      parallelFor(n, minRange, [&](int begin, int end)
+      {
+        Scratch local;
+        for (int v = begin; v < end; ++v)
+        {
+          candidates[v] = evaluate(v, local);
+        }
+      });
+      for (int v = 0; v < n; ++v)
+      {
+        refresh(v);
+      }
+
+      while (result.triangles > targetTriangles && !heap.empty())
+      {
+        int v = heap.top();
+        Candidate candidate = candidates[v];
+        if (candidate.cost > maxError)
+        {
+          break;
+        }
+        int u = candidate.target;
+        if (!canCollapse(v, u, candidate.position, scratch))
+        {
+          // Invalidated by a collapse nearby
+          candidates[v] = evaluate(v, scratch);
+          refresh(v);
+          continue;
+        }
+        result.triangles -= edgeTriangleCount(v, u);
+        mesh.edgeCollapse(v, u, candidate.position);
+        quadrics[v] += quadrics[u];
+        boundary[v] |= boundary[u];
+        heap.remove(u);
+        ++result.collapses;
+        result.error = (float)candidate.cost;
+
+        // An edge is represented by both end points and the collapse rule is symmetric, so v
+        // covers its new edges. Neighbors only need a new candidate if theirs was an edge to v or
+        // u, or if they had none, since the change may have unblocked one of their edges.
+        candidates[v] = evaluate(v, scratch);
+        refresh(v);
+        oneRing(v, neighbors);
+        for (int w : neighbors)
+        {
+          int target = candidates[w].target;
+          if (target == v || target == u || target < 0)
+          {
+            candidates[w] = evaluate(w, scratch);
+            refresh(w);
+          }
+        }
+      }
+
+      mesh.compact();
+      mesh.computeNormals();
+      return result;
+    }
+
+  private:
+    Mesh &mesh;
+    std::vector<Quadric> quadrics;
+    // Whether a vertex lies on the boundary, which a permitted collapse only passes on to the
+    // remaining vertex
+    std::vector<char> boundary;
+    std::vector<Candidate> candidates;
+    VertexHeap heap;
+    Scratch scratch;
+    std::vector<int> neighbors;
+
+    // Sorted distinct vertices sharing a triangle with v
+    void oneRing(int v, std::vector<int> &ring) const
+    {
+      ring.clear();
+      const Triangle *triangles = mesh.triangleData();
+      for (int t : mesh.adjacentTriangles(v))
+      {
+        for (int corner : triangles[t].vertices)
+        {
+          if (corner != v)
+          {
+            ring.push_back(corner);
+          }
+        }
+      }
+      std::sort(ring.begin(), ring.end());
+      ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    }
+
+    void refresh(int v)
+    {
+      if (candidates[v].target >= 0)
+      {
+        heap.update(v, candidates[v].cost);
+      }
+      else
+      {
+        heap.remove(v);
+      }
+    }
+
+    // Number of triangles on edge (a, b)
+    int edgeTriangleCount(int a, int b) const
+    {
+      int count = 0;
+      for (int t : mesh.adjacentTriangles(a))
+      {
+        count += hasCorner(mesh.triangleData()[t], b);
+      }
+      return count;
+    }
+
+    // Planes of the triangles around v and of its boundary edges
+    Quadric vertexQuadric(int v) const
+    {
+      Quadric q;
+      const Triangle *triangles = mesh.triangleData();
+      for (int t : mesh.adjacentTriangles(v))
+      {
+        const int *corners = triangles[t].vertices;
+        glm::vec3 p0 = mesh.position(corners[0]), p1 = mesh.position(corners[1]), p2 = mesh.position(corners[2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (!(length > 0.0f))
+        {
+          continue;
+        }
+        normal = normal / length;
+        q.addPlane(normal, p0, 1.0);
+        for (int i = 0; i < 3; ++i)
+        {
+          int a = corners[i], b = corners[(i + 1) % 3];
+          if ((a == v || b == v) && edgeTriangleCount(a, b) == 1)
+          {
+            glm::vec3 side = glm::cross(mesh.position(b) - mesh.position(a), normal);
+            float sideLength = glm::length(side);
+            if (sideLength > 0.0f)
+            {
+              q.addPlane(side / sideLength, mesh.position(a), boundaryWeight);
+            }
+          }
+        }
+      }
+      return q;
+    }
+
+    // Link condition, a valence check on the opposite corners and a fold-over test for
+    // merging b into a at position p
+    bool canCollapse(int a, int b, const glm::vec3 &p, Scratch &local) const
+    {
+      const Triangle *triangles = mesh.triangleData();
+      int opposite[2];
+      int nOpposite = 0;
+      for (int t : mesh.adjacentTriangles(a))
+      {
+        const int *corners = triangles[t].vertices;
+        if (!hasCorner(triangles[t], b))
+        {
+          continue;
+        }
+        if (nOpposite == 2)
+        {
+          return false; // non-manifold edge
+        }
+        opposite[nOpposite++] = corners[0] != a && corners[0] != b ? corners[0] : corners[1] != a && corners[1] != b ? corners[1] : corners[2];
+      }
+      if (nOpposite == 0 || (nOpposite == 2 && boundary[a] && boundary[b]))
+      {
+        return false;
+      }
+
+      // a and b may only share the opposite corners
+      oneRing(a, local.ringA);
+      oneRing(b, local.ringB);
+      int common = 0;
+      for (size_t i = 0, j = 0; i < local.ringA.size() && j < local.ringB.size();)
+      {
+        if (local.ringA[i] < local.ringB[j])
+        {
+          ++i;
+        }
+        else if (local.ringB[j] < local.ringA[i])
+        {
+          ++j;
+        }
+        else
+        {
+          ++common;
+          ++i;
+          ++j;
+        }
+      }
+      if (common != nOpposite)
+      {
+        return false;
+      }
+
+      // Every opposite corner loses a triangle, it must keep enough to stay a manifold fan
+      for (int i = 0; i < nOpposite; ++i)
+      {
+        if (mesh.adjacentTriangles(opposite[i]).size() <= (boundary[opposite[i]] ? 1 : 3))
+        {
+          return false;
+        }
+      }
+
+      // The triangles that stay must not turn over
+      int ends[2] = {a, b};
+      for (int e : ends)
+      {
+        for (int t : mesh.adjacentTriangles(e))
+        {
+          if (hasCorner(triangles[t], a) && hasCorner(triangles[t], b))
+          {
+            continue;
+          }
+          glm::vec3 before[3], after[3];
+          for (int i = 0; i < 3; ++i)
+          {
+            int corner = triangles[t].vertices[i];
+            before[i] = mesh.position(corner);
+            after[i] = corner == e ? p : before[i];
+          }
+          glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+          glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+          if (!(glm::dot(normalBefore, normalAfter) > 0.0f))
+          {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    // Cheapest edge of v that may be collapsed, placing the merged vertex at the minimizer of
+    // the combined quadric (or the best of the end points and the midpoint if there is none)
+    Candidate evaluate(int v, Scratch &local) const
+    {
+      std::vector<Candidate> &options = local.options;
+      options.clear();
+      oneRing(v, local.ring);
+      for (int u : local.ring)
+      {
+        Quadric q = quadrics[v];
+        q += quadrics[u];
+        glm::vec3 points[4] = {mesh.position(v), mesh.position(u), (mesh.position(v) + mesh.position(u)) / 2.0f, glm::vec3(0.0f)};
+        int nPoints = q.minimizer(points[3]) ? 4 : 3;
+        Candidate option = {q.error(points[0]), u, points[0]};
+        for (int i = 1; i < nPoints; ++i)
+        {
+          double e = q.error(points[i]);
+          if (e < option.cost)
+          {
+            option.cost = e;
+            option.position = points[i];
+          }
+        }
+        options.push_back(option);
+      }
+      // Cheapest first; usually the first one is allowed, so select instead of sorting
+      while (!options.empty())
+      {
+        size_t best = 0;
+        for (size_t i = 1; i < options.size(); ++i)
+        {
+          if (options[i].cost < options[best].cost || (options[i].cost == options[best].cost && options[i].target < options[best].target))
+          {
+            best = i;
+          }
+        }
+        if (canCollapse(v, options[best].target, options[best].position, local))
+        {
+          return options[best];
+        }
+        options[best] = options.back();
+        options.pop_back();
+      }
+      Candidate none = {0.0, -1, glm::vec3(0.0f)};
+      return none;
+    }
+  };
+}
+
+DecimationResult decimateQuadric(Mesh &mesh, int targetTriangles, float maxError)
+{
+  QuadricDecimator decimator(mesh);
+  return decimator.run(targetTriangles, maxError);
+}
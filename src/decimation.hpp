@@ -0,0 +1,24 @@
+#ifndef DECIMATION_HPP
+#define DECIMATION_HPP
+
+#include <limits>
+#include "mesh.hpp"
+
+// Outcome of a decimation run
+struct DecimationResult
+{
+  int collapses; // edges collapsed
+  int triangles; // triangles left
+  float error;   // quadric error of the last collapse
+};
+
+// Quadric error metric decimation (Garland and Heckbert). Every vertex carries the sum of the
+// squared-distance quadrics of the planes of its triangles, plus heavily weighted planes
+// perpendicular to its boundary edges. An edge costs the error of the combined quadric at the
+// point that minimizes it. Edges are collapsed cheapest first until at most targetTriangles
+// triangles are left or the next collapse would cost more than maxError.
+// Collapses that break the link condition (the mesh would stop being manifold) or fold a
+// triangle over are skipped. The mesh is compacted and its normals recomputed at the end.
+DecimationResult decimateQuadric(Mesh &mesh, int targetTriangles, float maxError = std::numeric_limits<float>::max());
+
+#endif // DECIMATION_HPP
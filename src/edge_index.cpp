@@ -0,0 +1,241 @@
+#include "edge_index.hpp"
+
+#include <algorithm>
+
+namespace
+{
+  const uint64_t emptyKey = ~(uint64_t)0;
+}
+
+EdgeIndex::EdgeIndex() : count(0)
+{
+}
+
+uint64_t EdgeIndex::edgeKey(int v1, int v2)
+{
+  if (v1 > v2)
+  {
+    std::swap(v1, v2);
+  }
+  return ((uint64_t)(uint32_t)v1 << 32) | (uint32_t)v2;
+}
+
+size_t EdgeIndex::home(uint64_t key) const
+{
+  return (size_t)hashKey(key) & (slots.size() - 1);
+}
+
+void EdgeIndex::reserve(size_t nEdges)
+{
+  size_t capacity = 16;
+  while (capacity < 2 * nEdges)
+  {
+    capacity *= 2;
+  }
+  if (capacity <= slots.size())
+  {
+    return;
+  }
+  std::vector<Slot> old;
+  old.swap(slots);
+  Slot empty = {emptyKey, {-1, -1}, 0};
+  slots.assign(capacity, empty);
+  for (const Slot &slot : old)
+  {
+    if (slot.key != emptyKey)
+    {
+      size_t i = home(slot.key);
+      while (slots[i].key != emptyKey)
+      {
+        i = (i + 1) & (slots.size() - 1);
+      }
+      slots[i] = slot;
+    }
+  }
+}
+
+void EdgeIndex::build(const int *triangles, int nTriangles)
+{
+  slots.clear();
+  overflow.clear();
+  count = 0;
+  // A closed manifold has 3/2 edges per triangle
+  reserve(3 * (size_t)nTriangles / 2 + 1);
+  for (int t = 0; t < nTriangles; ++t)
+  {
+    insertTriangle(t, triangles[3 * t], triangles[3 * t + 1], triangles[3 * t + 2]);
+  }
+}
+
+void EdgeIndex::insertTriangle(int t, int v0, int v1, int v2)
+{
+  insert(edgeKey(v0, v1), t);
+  insert(edgeKey(v1, v2), t);
+  insert(edgeKey(v2, v0), t);
+}
+
+void EdgeIndex::removeTriangle(int t, int v0, int v1, int v2)
+{
+  erase(edgeKey(v0, v1), t);
+  erase(edgeKey(v1, v2), t);
+  erase(edgeKey(v2, v0), t);
+}
+
+void EdgeIndex::insert(uint64_t key, int t)
+{
+  reserve(count + 1);
+  size_t i = home(key);
+  while (slots[i].key != emptyKey && slots[i].key != key)
+  {
+    i = (i + 1) & (slots.size() - 1);
+  }
+  Slot &slot = slots[i];
+  if (slot.key == emptyKey)
+  {
+    slot.key = key;
+    slot.triangles[0] = t;
+    slot.triangles[1] = -1;
+    slot.extra = 0;
+    ++count;
+    return;
+  }
+  if (slot.triangles[0] == t || slot.triangles[1] == t || (slot.extra > 0 && findOverflow(key, t) >= 0))
+  {
+    return;
+  }
+  if (slot.triangles[1] < 0)
+  {
+    slot.triangles[1] = std::max(slot.triangles[0], t);
+    slot.triangles[0] = std::min(slot.triangles[0], t);
+    return;
+  }
+
+  // Non-manifold edge: the slot keeps the two lowest triangles, the others go to the overflow list
+  int spill = t;
+  if (t < slot.triangles[1])
+  {
+    spill = slot.triangles[1];
+    slot.triangles[1] = std::max(slot.triangles[0], t);
+    slot.triangles[0] = std::min(slot.triangles[0], t);
+  }
+  overflow.push_back(std::make_pair(key, spill));
+  ++slot.extra;
+}
+
+void EdgeIndex::erase(uint64_t key, int t)
+{
+  if (slots.empty())
+  {
+    return;
+  }
+  size_t mask = slots.size() - 1;
+  size_t i = home(key);
+  while (slots[i].key != key)
+  {
+    if (slots[i].key == emptyKey)
+    {
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  Slot &slot = slots[i];
+  if (slot.triangles[0] == t)
+  {
+    slot.triangles[0] = slot.triangles[1];
+    slot.triangles[1] = -1;
+  }
+  else if (slot.triangles[1] == t)
+  {
+    slot.triangles[1] = -1;
+  }
+  else
+  {
+    int j = slot.extra > 0 ? findOverflow(key, t) : -1;
+    if (j >= 0)
+    {
+      overflow[j] = overflow.back();
+      overflow.pop_back();
+      --slot.extra;
+    }
+    return;
+  }
+  if (slot.extra > 0)
+  {
+    // Every overflow triangle is above the remaining one, refill with the lowest
+    int lowest = -1;
+    for (int j = 0; j < overflow.size(); ++j)
+    {
+      if (overflow[j].first == key && (lowest < 0 || overflow[j].second < overflow[lowest].second))
+      {
+        lowest = j;
+      }
+    }
+    slot.triangles[1] = overflow[lowest].second;
+    overflow[lowest] = overflow.back();
+    overflow.pop_back();
+    --slot.extra;
+  }
+  if (slot.triangles[0] >= 0)
+  {
+    return;
+  }
+
+  // Last triangle of the edge: remove the slot and shift back the entries probing past it
+  --count;
+  size_t hole = i;
+  for (size_t j = (i + 1) & mask; slots[j].key != emptyKey; j = (j + 1) & mask)
+  {
+    size_t h = home(slots[j].key);
+    // Move j into the hole unless its home lies cyclically in (hole, j]
+    bool between = hole <= j ? (hole < h && h <= j) : (hole < h || h <= j);
+    if (!between)
+    {
+      slots[hole] = slots[j];
+      hole = j;
+    }
+  }
+  slots[hole].key = emptyKey;
+}
+
+int EdgeIndex::findOverflow(uint64_t key, int t) const
+{
+  for (int j = 0; j < overflow.size(); ++j)
+  {
+    if (overflow[j].first == key && overflow[j].second == t)
+    {
+      return j;
+    }
+  }
+  return -1;
+}
+
+const EdgeIndex::Slot *EdgeIndex::lookup(uint64_t key) const
+{
+  if (slots.empty())
+  {
+    return nullptr;
+  }
+  size_t i = home(key);
+  while (slots[i].key != emptyKey)
+  {
+    if (slots[i].key == key)
+    {
+      return &slots[i];
+    }
+    i = (i + 1) & (slots.size() - 1);
+  }
+  return nullptr;
+}
+
+bool EdgeIndex::find(int v1, int v2, int &t1, int &t2) const
+{
+  const Slot *slot = lookup(edgeKey(v1, v2));
+  t1 = slot != nullptr ? slot->triangles[0] : -1;
+  t2 = slot != nullptr ? slot->triangles[1] : -1;
+  return slot != nullptr;
+}
+
+bool EdgeIndex::contains(int v1, int v2) const
+{
+  return lookup(edgeKey(v1, v2)) != nullptr;
+}
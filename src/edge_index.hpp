@@ -0,0 +1,67 @@
+#ifndef EDGE_INDEX_HPP
+#define EDGE_INDEX_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// Hash of a 64-bit key for a power-of-two table indexed by the low bits. Multiplying by 2^64/phi
+// spreads every key bit only upwards, so the low bits of the product depend on the low bits of
+// the key alone. Folding the high half onto the low half mixes the whole key into the bits the
+// table mask keeps.
+inline uint64_t hashKey(uint64_t key)
+{
+  uint64_t h = key * 0x9E3779B97F4A7C15ull;
+  return h ^ (h >> 32);
+}
+
+// Hash map from an undirected edge to the (up to two) triangles containing it.
+// Open addressing with linear probing over a power-of-two table kept at most half full,
+// so a lookup touches a few consecutive slots. Removal shifts the following entries back
+// instead of leaving tombstones, which keeps the table size bounded by the number of edges.
+class EdgeIndex
+{
+public:
+  EdgeIndex();
+
+  // Drop all edges and index the given triangles (3 vertex indices each)
+  void build(const int *triangles, int nTriangles);
+
+  // Add or remove the three edges of triangle t
+  void insertTriangle(int t, int v0, int v1, int v2);
+  void removeTriangle(int t, int v0, int v1, int v2);
+
+  // The two lowest triangles on edge (v1, v2) in increasing order, -1 where there are fewer than two.
+  // Returns false if no triangle contains the edge.
+  bool find(int v1, int v2, int &t1, int &t2) const;
+
+  bool contains(int v1, int v2) const;
+
+  // Number of distinct edges
+  int size() const { return count; }
+
+private:
+  struct Slot
+  {
+    uint64_t key;
+    int triangles[2]; // the two lowest triangles on the edge
+    int extra;        // number of further triangles in the overflow list
+  };
+
+  std::vector<Slot> slots;
+  int count;
+
+  // (edge, triangle) pairs past the first two of non-manifold edges, expected to stay tiny
+  std::vector<std::pair<uint64_t, int>> overflow;
+
+  static uint64_t edgeKey(int v1, int v2);
+  size_t home(uint64_t key) const;
+  void reserve(size_t nEdges);
+  void insert(uint64_t key, int t);
+  void erase(uint64_t key, int t);
+  int findOverflow(uint64_t key, int t) const;
+  const Slot *lookup(uint64_t key) const;
+};
+
+#endif // EDGE_INDEX_HPP
@@ -0,0 +1,159 @@
+#include "fairing.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+  // Rows per reduction block. Dot products are summed per block and then over the blocks in
+  // order, so the result does not depend on the thread count.
+  const int blockRows = 4096;
+
+  struct Sum3
+  {
+    double x, y, z;
+  };
+
+  // Run fn(begin, end, sum) on fixed blocks of rows in parallel and add up the block sums
+  template <typename Function>
+  Sum3 reduceBlocks(int n, Function fn)
+  {
+    int nBlocks = (n + blockRows - 1) / blockRows;
+    std::vector<Sum3> partial(nBlocks);
+    parallelFor(nBlocks, 1, [&](int first, int last)
+    {
+      for (int b = first; b < last; ++b)
+      {
+        Sum3 sum = {0.0, 0.0, 0.0};
+        fn(b * blockRows, std::min(n, (b + 1) * blockRows), sum);
+        partial[b] = sum;
+      }
+    });
+    Sum3 total = {0.0, 0.0, 0.0};
+    for (const Sum3 &sum : partial)
+    {
+      total.x += sum.x;
+      total.y += sum.y;
+      total.z += sum.z;
+    }
+    return total;
+  }
+
+  void accumulate(Sum3 &sum, const glm::vec3 &a, const glm::vec3 &b)
+  {
+    sum.x += (double)a.x * b.x;
+    sum.y += (double)a.y * b.y;
+    sum.z += (double)a.z * b.z;
+  }
+
+  // Per-coordinate ratio, 0 where the denominator vanishes (that coordinate has converged)
+  glm::vec3 ratio(const Sum3 &a, const Sum3 &b)
+  {
+    return glm::vec3(b.x != 0.0 ? (float)(a.x / b.x) : 0.0f, b.y != 0.0 ? (float)(a.y / b.y) : 0.0f, b.z != 0.0 ? (float)(a.z / b.z) : 0.0f);
+  }
+}
+
+int solveImplicitFairing(const LaplacianOperator &op, const glm::vec3 *b, float lambda, int maxIterations, float tolerance, glm::vec3 *x)
+{
+  int n = op.size();
+  const int *rowOffsets = op.rowOffsetData();
+  const int *columns = op.columnData();
+  const float *weights = op.weightData();
+  const float *degrees = op.degreeData();
+
+  // Row i of A p is (1 + lambda) D_i p_i - lambda D_i sum_j w_ij p_j
+  auto multiply = [&](int i, const glm::vec3 *p)
+  {
+    glm::vec3 sum(0.0f);
+    for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; ++k)
+    {
+      sum += weights[k] * p[columns[k]];
+    }
+    return degrees[i] * ((1.0f + lambda) * p[i] - lambda * sum);
+  };
+
+  std::vector<float> inverseDiagonal(n);
+  std::vector<glm::vec3> r(n), z(n), p(n), q(n);
+  Sum3 rhsNorm = reduceBlocks(n, [&](int begin, int end, Sum3 &sum)
+  {
+    for (int i = begin; i < end; ++i)
+    {
+      float selfWeight = 0.0f;
+      for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; ++k)
+      {
+        if (columns[k] == i)
+        {
+          selfWeight = weights[k];
+        }
+      }
+      inverseDiagonal[i] = 1.0f / (degrees[i] * (1.0f + lambda - lambda * selfWeight));
+      r[i] = degrees[i] * b[i] - multiply(i, x);
+      z[i] = inverseDiagonal[i] * r[i];
+      p[i] = z[i];
+      glm::vec3 rhs = degrees[i] * b[i];
+      accumulate(sum, rhs, rhs);
+    }
+  });
+  Sum3 rz = reduceBlocks(n, [&](int begin, int end, Sum3 &sum)
+  {
+    for (int i = begin; i < end; ++i)
+    {
+      accumulate(sum, r[i], z[i]);
+    }
+  });
+
+  // Squared residual thresholds per coordinate
+  double t2 = (double)tolerance * tolerance;
+  Sum3 limit = {t2 * rhsNorm.x, t2 * rhsNorm.y, t2 * rhsNorm.z};
+  Sum3 rr = reduceBlocks(n, [&](int begin, int end, Sum3 &sum)
+  {
+    for (int i = begin; i < end; ++i)
+    {
+      accumulate(sum, r[i], r[i]);
+    }
+  });
+
+  int it = 0;
+  while (it < maxIterations && !(rr.x <= limit.x && rr.y <= limit.y && rr.z <= limit.z))
+  {
+    Sum3 pq = reduceBlocks(n, [&](int begin, int end, Sum3 &sum)
+    {
+      for (int i = begin; i < end; ++i)
+      {
+        q[i] = multiply(i, p.data());
+        accumulate(sum, p[i], q[i]);
+      }
+    });
+    glm::vec3 alpha = ratio(rz, pq);
+    rr = reduceBlocks(n, [&](int begin, int end, Sum3 &sum)
+    {
+      for (int i = begin; i < end; ++i)
+      {
+        x[i] += alpha * p[i];
+        r[i] -= alpha * q[i];
+        accumulate(sum, r[i], r[i]);
+      }
+    });
+    ++it;
+
+    Sum3 rzNext = reduceBlocks(n, [&](int begin, int end, Sum3 &sum)
+    {
+      for (int i = begin; i < end; ++i)
+      {
+        z[i] = inverseDiagonal[i] * r[i];
+        accumulate(sum, r[i], z[i]);
+      }
+    });
+    glm::vec3 beta = ratio(rzNext, rz);
+    rz = rzNext;
+    parallelFor(n, blockRows, [&](int begin, int end)
+    {
+      for (int i = begin; i < end; ++i)
+      {
+        p[i] = z[i] + beta * p[i];
+      }
+    });
+  }
+  return it;
+}
@@ -0,0 +1,17 @@
+#ifndef FAIRING_HPP
+#define FAIRING_HPP
+
+#include <glm/glm.hpp>
+#include "laplacian.hpp"
+
+// Backward Euler step of umbrella smoothing: solve (I - lambda L) x = b, where L = W - I and
+// W is the averaging operator op. Multiplied by the degrees D the system becomes symmetric
+// positive definite, ((1 + lambda) D - lambda D W) x = D b, and is solved with Jacobi
+// preconditioned conjugate gradient. The three coordinates are solved in lockstep so every
+// pass over the matrix serves all of them.
+// x holds the initial guess on entry and the solution on return. Stops once the residual of
+// every coordinate is below tolerance relative to |D b|, or after maxIterations.
+// Returns the number of iterations.
+int solveImplicitFairing(const LaplacianOperator &op, const glm::vec3 *b, float lambda, int maxIterations, float tolerance, glm::vec3 *x);
+
+#endif // FAIRING_HPP
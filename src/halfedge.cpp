@@ -0,0 +1,345 @@
+#include "halfedge.hpp"
+#include "parallel.hpp"
+
+HalfEdgeMesh::HalfEdgeMesh(const Mesh &mesh) : markStamp(0)
+{
+  int nVertices = mesh.numVertices();
+  int nTriangles = mesh.numTriangles();
+  positions.assign(mesh.positionData(), mesh.positionData() + nVertices);
+  normals.assign(mesh.normalData(), mesh.normalData() + nVertices);
+  vertexDeleted.resize(nVertices);
+  for (int v = 0; v < nVertices; ++v)
+  {
+    vertexDeleted[v] = mesh.isDeletedVertex(v);
+  }
+  marks.assign(nVertices, 0);
+
+  const Triangle *triangles = mesh.triangleData();
+  sources.resize(3 * nTriangles);
+  for (int f = 0; f < nTriangles; ++f)
+  {
+    // Triangles deleted by Mesh::edgeCollapse stay deleted here
+    bool deleted = mesh.isDeletedTriangle(f);
+    for (int i = 0; i < 3; ++i)
+    {
+      sources[3 * f + i] = deleted ? -1 : triangles[f].vertices[i];
+    }
+  }
+
+  // The twin of a->b is the b->a half-edge in one of the triangles around b.
+  // Edges shared by more than two triangles or by triangles with opposite orientation stay unpaired.
+  twins.assign(3 * nTriangles, -1);
+  parallelFor(3 * nTriangles, 4096, [&](int begin, int end)
+  {
+    for (int h = begin; h < end; ++h)
+    {
+      if (sources[h] < 0)
+      {
+        continue;
+      }
+      int a = source(h), b = target(h);
+      int found = -1, count = 0;
+      for (int g : mesh.adjacentTriangles(b))
+      {
+        for (int i = 0; i < 3; ++i)
+        {
+          if (g != face(h) && triangles[g].vertices[i] == a && (triangles[g].vertices[(i + 1) % 3] == b || triangles[g].vertices[(i + 2) % 3] == b))
+          {
+            if (triangles[g].vertices[(i + 2) % 3] == b)
+            {
+              found = 3 * g + (i + 2) % 3;
+            }
+            ++count;
+          }
+        }
+      }
+      twins[h] = count == 1 ? found : -1;
+    }
+  });
+
+  outgoingEdges.assign(nVertices, -1);
+  for (int h = 0; h < 3 * nTriangles; ++h)
+  {
+    if (sources[h] >= 0 && (outgoingEdges[sources[h]] < 0 || twins[h] < 0))
+    {
+      outgoingEdges[sources[h]] = h;
+    }
+  }
+}
+
+void HalfEdgeMesh::toMesh(Mesh &mesh) const
+{
+  std::vector<int> remap(positions.size(), -1);
+  std::vector<glm::vec3> livePositions, liveNormals;
+  for (int v = 0; v < positions.size(); ++v)
+  {
+    if (!vertexDeleted[v])
+    {
+      remap[v] = livePositions.size();
+      livePositions.push_back(positions[v]);
+      liveNormals.push_back(normals[v]);
+    }
+  }
+  std::vector<glm::ivec3> liveTriangles;
+  for (int f = 0; f < numTriangles(); ++f)
+  {
+    if (!isDeletedFace(f))
+    {
+      liveTriangles.push_back(glm::ivec3(remap[sources[3 * f]], remap[sources[3 * f + 1]], remap[sources[3 * f + 2]]));
+    }
+  }
+  mesh.setMeshData(livePositions, liveNormals, liveTriangles, Mesh::buildVertexFaceMap(liveTriangles, livePositions.size()));
+}
+
+int HalfEdgeMesh::valence(int v) const
+{
+  int count = 0;
+  forEachNeighbor(v, [&](int)
+  {
+    ++count;
+  });
+  return count;
+}
+
+int HalfEdgeMesh::findHalfEdge(int v1, int v2) const
+{
+  int h0 = outgoingEdges[v1];
+  if (h0 < 0)
+  {
+    return -1;
+  }
+  int h = h0;
+  do
+  {
+    if (target(h) == v2)
+    {
+      return h;
+    }
+    h = nextOutgoing(h);
+  } while (h >= 0 && h != h0);
+  return -1;
+}
+
+void HalfEdgeMesh::setFace(int f, int v0, int v1, int v2)
+{
+  sources[3 * f] = v0;
+  sources[3 * f + 1] = v1;
+  sources[3 * f + 2] = v2;
+}
+
+void HalfEdgeMesh::link(int h1, int h2)
+{
+  if (h1 >= 0)
+  {
+    twins[h1] = h2;
+  }
+  if (h2 >= 0)
+  {
+    twins[h2] = h1;
+  }
+}
+
+void HalfEdgeMesh::repairOutgoing(int v, int h)
+{
+  // Turn backwards around v until the boundary or all the way around
+  int start = h;
+  while (twins[h] >= 0 && next(twins[h]) != start)
+  {
+    h = next(twins[h]);
+  }
+  outgoingEdges[v] = h;
+}
+
+bool HalfEdgeMesh::flip(int h)
+{
+  int t = twins[h];
+  if (t < 0)
+  {
+    return false;
+  }
+  int f0 = face(h), f1 = face(t);
+  int a = source(h), b = target(h), c = source(prev(h)), d = source(prev(t));
+  if (c == d || findHalfEdge(c, d) >= 0 || findHalfEdge(d, c) >= 0)
+  {
+    return false;
+  }
+  int bc = twins[next(h)], ca = twins[prev(h)], ad = twins[next(t)], db = twins[prev(t)];
+
+  // (a, b, c), (b, a, d) become (a, d, c), (b, c, d)
+  setFace(f0, a, d, c);
+  setFace(f1, b, c, d);
+  link(3 * f0, ad);
+  link(3 * f0 + 1, 3 * f1 + 1);
+  link(3 * f0 + 2, ca);
+  link(3 * f1, bc);
+  link(3 * f1 + 2, db);
+
+  repairOutgoing(a, 3 * f0);
+  repairOutgoing(b, 3 * f1);
+  repairOutgoing(c, 3 * f0 + 2);
+  repairOutgoing(d, 3 * f0 + 1);
+  return true;
+}
+
+int HalfEdgeMesh::split(int h)
+{
+  int t = twins[h];
+  int f0 = face(h);
+  int a = source(h), b = target(h), c = source(prev(h));
+  int bc = twins[next(h)], ca = twins[prev(h)];
+
+  int m = positions.size();
+  positions.push_back((positions[a] + positions[b]) / 2.0f);
+  glm::vec3 normal = normals[a] + normals[b];
+  float l = glm::length(normal);
+  normals.push_back(l > 0.0f ? normal / l : normal);
+  outgoingEdges.push_back(-1);
+  vertexDeleted.push_back(0);
+  marks.push_back(0);
+
+  // (a, b, c) becomes (a, m, c), (m, b, c)
+  int f2 = numTriangles();
+  sources.resize(sources.size() + 3);
+  twins.resize(twins.size() + 3, -1);
+  setFace(f0, a, m, c);
+  setFace(f2, m, b, c);
+  link(3 * f0 + 1, 3 * f2 + 2);
+  link(3 * f0 + 2, ca);
+  link(3 * f2 + 1, bc);
+
+  if (t < 0)
+  {
+    twins[3 * f0] = -1;
+  }
+  else
+  {
+    // (b, a, d) becomes (m, a, d), (b, m, d)
+    int f1 = face(t);
+    int d = source(prev(t));
+    int ad = twins[next(t)], db = twins[prev(t)];
+    int f3 = numTriangles();
+    sources.resize(sources.size() + 3);
+    twins.resize(twins.size() + 3, -1);
+    setFace(f1, m, a, d);
+    setFace(f3, b, m, d);
+    link(3 * f0, 3 * f1);
+    link(3 * f2, 3 * f3);
+    link(3 * f1 + 1, ad);
+    link(3 * f1 + 2, 3 * f3 + 1);
+    link(3 * f3 + 2, db);
+    repairOutgoing(d, 3 * f1 + 2);
+  }
+
+  repairOutgoing(a, 3 * f0);
+  repairOutgoing(b, 3 * f2 + 1);
+  repairOutgoing(c, 3 * f0 + 2);
+  repairOutgoing(m, 3 * f0 + 1);
+  return m;
+}
+
+bool HalfEdgeMesh::collapse(int h, const glm::vec3 &pos)
+{
+  int t = twins[h];
+  int f0 = face(h);
+  int a = source(h), b = target(h), c = source(prev(h));
+  int d = t >= 0 ? source(prev(t)) : -1;
+
+  // An interior edge between two boundary vertices would pinch the mesh
+  if (c == d || (t >= 0 && isBoundaryVertex(a) && isBoundaryVertex(b)))
+  {
+    return false;
+  }
+  // The opposite corners lose an edge each, a valence 3 corner would be left with two stacked faces
+  if (valence(c) <= (isBoundaryVertex(c) ? 2 : 3) || (d >= 0 && valence(d) <= (isBoundaryVertex(d) ? 2 : 3)))
+  {
+    return false;
+  }
+  // Link condition: a and b may only share the opposite corners c and d
+  ++markStamp;
+  forEachNeighbor(a, [&](int u)
+  {
+    marks[u] = markStamp;
+  });
+  bool linkCondition = true;
+  forEachNeighbor(b, [&](int u)
+  {
+    if (marks[u] == markStamp && u != c && u != d)
+    {
+      linkCondition = false;
+    }
+  });
+  if (!linkCondition)
+  {
+    return false;
+  }
+
+  int bc = twins[next(h)], ca = twins[prev(h)];
+  int ad = t >= 0 ? twins[next(t)] : -1, db = t >= 0 ? twins[prev(t)] : -1;
+
+  // Every other corner at b moves to a
+  int hb = outgoingEdges[b];
+  int g = hb;
+  do
+  {
+    if (face(g) != f0 && (t < 0 || face(g) != face(t)))
+    {
+      sources[g] = a;
+    }
+    g = nextOutgoing(g);
+  } while (g >= 0 && g != hb);
+
+  // The outer edges of each removed triangle become twins of each other
+  link(bc, ca);
+  for (int i = 0; i < 3; ++i)
+  {
+    sources[3 * f0 + i] = -1;
+    twins[3 * f0 + i] = -1;
+  }
+  if (t >= 0)
+  {
+    link(ad, db);
+    int f1 = face(t);
+    for (int i = 0; i < 3; ++i)
+    {
+      sources[3 * f1 + i] = -1;
+      twins[3 * f1 + i] = -1;
+    }
+  }
+
+  positions[a] = pos;
+  glm::vec3 normal = normals[a] + normals[b];
+  float l = glm::length(normal);
+  normals[a] = l > 0.0f ? normal / l : normal;
+  vertexDeleted[b] = 1;
+  outgoingEdges[b] = -1;
+
+  // Restart the fans of the corners, from any half-edge that survived
+  if (ca >= 0)
+    repairOutgoing(a, ca);
+  else if (bc >= 0)
+    repairOutgoing(a, next(bc));
+  else if (db >= 0)
+    repairOutgoing(a, db);
+  else if (ad >= 0)
+    repairOutgoing(a, next(ad));
+  else
+    outgoingEdges[a] = -1;
+
+  if (bc >= 0)
+    repairOutgoing(c, bc);
+  else if (ca >= 0)
+    repairOutgoing(c, next(ca));
+  else
+    outgoingEdges[c] = -1;
+
+  if (d >= 0)
+  {
+    if (ad >= 0)
+      repairOutgoing(d, ad);
+    else if (db >= 0)
+      repairOutgoing(d, next(db));
+    else
+      outgoingEdges[d] = -1;
+  }
+  return true;
+}
@@ -0,0 +1,111 @@
+#ifndef HALFEDGE_HPP
+#define HALFEDGE_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+
+// Half-edge connectivity of a manifold triangle mesh, for running many local edits.
+// Half-edges 3f, 3f+1 and 3f+2 belong to triangle f (directed-edge layout): half-edge 3f+i
+// leaves corner i of the triangle and points to corner i+1, so next, prev and face are
+// index arithmetic and only the source vertex and the twin are stored.
+// Flip, split and collapse update the structure locally. Collapsed triangles and vertices
+// are marked deleted and dropped by toMesh.
+class HalfEdgeMesh
+{
+public:
+  explicit HalfEdgeMesh(const Mesh &mesh);
+
+  // Write the live vertices and triangles back into a mesh
+  void toMesh(Mesh &mesh) const;
+
+  int numVertices() const { return positions.size(); }
+  int numTriangles() const { return sources.size() / 3; }
+
+  // Topology queries, all O(1)
+  int next(int h) const { return h % 3 == 2 ? h - 2 : h + 1; }
+  int prev(int h) const { return h % 3 == 0 ? h + 2 : h - 1; }
+  int face(int h) const { return h / 3; }
+  int twin(int h) const { return twins[h]; } // -1 on the boundary
+  int source(int h) const { return sources[h]; }
+  int target(int h) const { return sources[next(h)]; }
+  // One outgoing half-edge of a vertex, the boundary one if the vertex is on the boundary (-1 if isolated)
+  int outgoing(int v) const { return outgoingEdges[v]; }
+  // The outgoing half-edge after h when turning around source(h), -1 past the last one on the boundary
+  int nextOutgoing(int h) const { return twins[prev(h)]; }
+
+  bool isDeletedVertex(int v) const { return vertexDeleted[v] != 0; }
+  bool isDeletedFace(int f) const { return sources[3 * f] < 0; }
+  bool isBoundaryVertex(int v) const { return outgoingEdges[v] >= 0 && twins[outgoingEdges[v]] < 0; }
+
+  // Number of edges around a vertex
+  int valence(int v) const;
+
+  // Half-edge from v1 to v2 or -1, O(valence)
+  int findHalfEdge(int v1, int v2) const;
+
+  // Call f(u) for every vertex u sharing an edge with v
+  template <typename Function>
+  void forEachNeighbor(int v, Function f) const
+  {
+    int h0 = outgoingEdges[v];
+    if (h0 < 0)
+    {
+      return;
+    }
+    int h = h0;
+    while (true)
+    {
+      f(target(h));
+      int n = nextOutgoing(h);
+      if (n < 0)
+      {
+        // Boundary fan, the last edge only has an incoming half-edge
+        f(source(prev(h)));
+        return;
+      }
+      if (n == h0)
+      {
+        return;
+      }
+      h = n;
+    }
+  }
+
+  const glm::vec3 &position(int v) const { return positions[v]; }
+  void setPosition(int v, const glm::vec3 &pos) { positions[v] = pos; }
+
+  // Flip the edge of h, returns false for boundary edges or if the new edge already exists
+  bool flip(int h);
+
+  // Split the edge of h at its midpoint, returns the new vertex
+  int split(int h);
+
+  // Merge target(h) into source(h), placing it at pos. Returns false if the link condition
+  // fails, i.e. the collapse would make the mesh non-manifold.
+  bool collapse(int h, const glm::vec3 &pos);
+
+private:
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<int> outgoingEdges;
+  std::vector<char> vertexDeleted;
+
+  std::vector<int> sources;
+  std::vector<int> twins;
+
+  // Per-vertex marks for neighborhood tests, valid where equal to markStamp
+  mutable std::vector<int> marks;
+  mutable int markStamp;
+
+  // Overwrite the corners of triangle f
+  void setFace(int f, int v0, int v1, int v2);
+
+  // Make h1 and h2 twins of each other (either may be -1)
+  void link(int h1, int h2);
+
+  // Point outgoing(v) at the first half-edge of its fan, starting from a half-edge h leaving v
+  void repairOutgoing(int v, int h);
+};
+
+#endif // HALFEDGE_HPP
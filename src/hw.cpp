@@ -1,5 +1,6 @@
 #include "hw.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -156,15 +157,23 @@ namespace COL781 {
         Object Rasterizer::createObject() {
             Object object;
             glGenVertexArrays(1, &object.vao);
+            object.nTris = 0;
+            for (int i = 0; i < maxVertexAttribs; i++) {
+                object.attribBuffers[i] = 0;
+            }
+            object.indexBuffer = 0;
+            object.vertexBuffer = 0;
+            object.vertexBytes = 0;
             glCheckError();
             return object;
         }
 
+        // Each attribute keeps its buffer, so setting it again does not leak the old one
         void setAttribs(Object &object, int attribIndex, int n, int d, const float* data) {
-            GLuint vbo;
-            glGenBuffers(1, &vbo);
+            if (!object.attribBuffers[attribIndex])
+                glGenBuffers(1, &object.attribBuffers[attribIndex]);
             glBindVertexArray(object.vao);
-            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, object.attribBuffers[attribIndex]);
             glBufferData(GL_ARRAY_BUFFER, n*d*sizeof(float), data, GL_STATIC_DRAW);
             glVertexAttribPointer(attribIndex, d, GL_FLOAT, GL_FALSE, d*sizeof(float), NULL);
             glEnableVertexAttribArray(attribIndex);
@@ -187,11 +196,45 @@ namespace COL781 {
             setAttribs(object, attribIndex, n, 4, (float*)data);
         }
 
+        void Rasterizer::setInterleavedVertices(Object &object, int n, const glm::vec3* positions, const glm::vec3* normals, int chunkVertices) {
+            const GLsizei stride = 2*sizeof(glm::vec3);
+            if (!object.vertexBuffer)
+                glGenBuffers(1, &object.vertexBuffer);
+            glBindVertexArray(object.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, object.vertexBuffer);
+            GLsizeiptr bytes = (GLsizeiptr)n*stride;
+            if (bytes > object.vertexBytes) {
+                // Allocate only, the chunks below fill it
+                glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+                object.vertexBytes = bytes;
+            }
+            for (int begin = 0; begin < n; begin += chunkVertices) {
+                int count = std::min(chunkVertices, n - begin);
+                glm::vec3 *out = (glm::vec3*)glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)begin*stride, (GLsizeiptr)count*stride,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+                if (!out) {
+                    std::cerr << "Could not map the vertex buffer" << std::endl;
+                    break;
+                }
+                for (int i = 0; i < count; i++) {
+                    out[2*i] = positions[begin + i];
+                    out[2*i + 1] = normals[begin + i];
+                }
+                if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+                    std::cerr << "Vertex buffer was lost while mapped" << std::endl;
+            }
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)sizeof(glm::vec3));
+            glEnableVertexAttribArray(0);
+            glEnableVertexAttribArray(1);
+            glCheckError();
+        }
+
         void Rasterizer::setTriangleIndices(Object &object, int n, const glm::ivec3* indices) {
-            GLuint ebo;
-            glGenBuffers(1, &ebo);
+            if (!object.indexBuffer)
+                glGenBuffers(1, &object.indexBuffer);
             glBindVertexArray(object.vao);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.indexBuffer);
             glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3*n*sizeof(int), (float*)indices, GL_STATIC_DRAW);
             object.nTris = n;
             glCheckError();
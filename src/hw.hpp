@@ -14,9 +14,18 @@ namespace COL781 {
 
         using ShaderProgram = GLuint;
 
+        // Vertex attributes an object can have
+        const int maxVertexAttribs = 4;
+
         struct Object {
             GLuint vao;
             int nTris;
+            // Buffer of every vertex attribute, 0 until it is set
+            GLuint attribBuffers[maxVertexAttribs];
+            GLuint indexBuffer;
+            // Buffer holding positions and normals interleaved (see setInterleavedVertices) and its size in bytes
+            GLuint vertexBuffer;
+            GLsizeiptr vertexBytes;
         };
 
         class Rasterizer {
@@ -56,6 +65,13 @@ namespace COL781 {
             // T is only allowed to be float, glm::vec2, glm::vec3, or glm::vec4.
             template <typename T> void setVertexAttribs(Object &object, int attribIndex, int n, const T* data);
 
+            // Sets positions (attribute 0) and normals (attribute 1) from one buffer holding them
+            // interleaved, so a vertex is read from one place. The buffer is filled in chunks of
+            // chunkVertices mapped with glMapBufferRange and written straight from the two arrays,
+            // without an interleaved copy of the whole mesh in memory. It is only reallocated if the
+            // data no longer fits, so it also serves data that changes every frame.
+            void setInterleavedVertices(Object &object, int n, const glm::vec3* positions, const glm::vec3* normals, int chunkVertices = 1 << 16);
+
             // Sets the indices of the triangles.
             void setTriangleIndices(Object &mesh, int n, const glm::ivec3* indices);
 
@@ -0,0 +1,506 @@
+#include "laplacian.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LAPLACIAN_HAVE_AVX2 1
+#endif
+
+namespace
+{
+  // Rows per parallel range
+  const int minRange = 4096;
+
+  // Rows per tile of the cache-blocked Taubin step, sized so the positions, both temporary
+  // buffers and the CSR entries of a tile stay in L2 between the two half steps
+  const int tileRows = 2048;
+
+  // Sorted other corners of the triangles around v, one entry per occurrence
+  void collectRow(int v, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency, std::vector<int> &corners)
+  {
+    corners.clear();
+    for (int k = adjacencyBegin[v]; k < adjacencyEnd[v]; ++k)
+    {
+      const int *t = triangles + 3 * adjacency[k];
+      for (int c = 0; c < 3; ++c)
+      {
+        if (t[c] != v)
+        {
+          corners.push_back(t[c]);
+        }
+      }
+    }
+    std::sort(corners.begin(), corners.end());
+  }
+
+  // Squared length, summed in the same order on both kernels
+  inline float squaredLength(float x, float y, float z)
+  {
+    return (x * x + y * y) + z * z;
+  }
+
+  // Smooth rows [begin, end) and add the squared displacement of every row from reference
+  // into the block statistics, in row order
+  void smoothRowsScalar(int begin, int end, const int *rowOffsets, const int *columns, const float *weights, const glm::vec3 *in, float lambda, glm::vec3 *out, const glm::vec3 *reference, StepDisplacement &displacement)
+  {
+    for (int i = begin; i < end; ++i)
+    {
+      float x = 0.0f, y = 0.0f, z = 0.0f;
+      for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; ++k)
+      {
+        const glm::vec3 &p = in[columns[k]];
+        x = x + weights[k] * p.x;
+        y = y + weights[k] * p.y;
+        z = z + weights[k] * p.z;
+      }
+      out[i].x = in[i].x + lambda * (x - in[i].x);
+      out[i].y = in[i].y + lambda * (y - in[i].y);
+      out[i].z = in[i].z + lambda * (z - in[i].z);
+      float d2 = squaredLength(out[i].x - reference[i].x, out[i].y - reference[i].y, out[i].z - reference[i].z);
+      displacement.sumSquared += d2;
+      displacement.maxSquared = std::max(displacement.maxSquared, d2);
+    }
+  }
+
+#ifdef LAPLACIAN_HAVE_AVX2
+  // Eight rows at a time, one row per lane: lane r adds the k-th entry of its row in step k,
+  // which is the scalar summation order. Positions are gathered straight from the vec3 array.
+  __attribute__((target("avx2"))) void smoothRowsAvx2(int begin, int end, const int *rowOffsets, const int *columns, const float *weights, const glm::vec3 *in, float lambda, glm::vec3 *out, const glm::vec3 *reference, StepDisplacement &displacement)
+  {
+    const float *coordinates = &in[0].x;
+    const float *referenceCoordinates = &reference[0].x;
+    const __m256 lambdas = _mm256_set1_ps(lambda);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+      __m256i first = _mm256_loadu_si256((const __m256i *)(rowOffsets + i));
+      __m256i length = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(rowOffsets + i + 1)), first);
+      int maxLength = 0;
+      for (int r = 0; r < 8; ++r)
+      {
+        maxLength = std::max(maxLength, rowOffsets[i + r + 1] - rowOffsets[i + r]);
+      }
+
+      __m256 x = _mm256_setzero_ps(), y = _mm256_setzero_ps(), z = _mm256_setzero_ps();
+      for (int k = 0; k < maxLength; ++k)
+      {
+        __m256i step = _mm256_set1_epi32(k);
+        __m256i active = _mm256_cmpgt_epi32(length, step);
+        __m256 activeMask = _mm256_castsi256_ps(active);
+        __m256i entry = _mm256_add_epi32(first, step);
+        __m256i column = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), columns, entry, active, 4);
+        __m256 w = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), weights, entry, activeMask, 4);
+        __m256i offset = _mm256_add_epi32(column, _mm256_add_epi32(column, column));
+        __m256 px = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), coordinates, offset, activeMask, 4);
+        __m256 py = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), coordinates + 1, offset, activeMask, 4);
+        __m256 pz = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), coordinates + 2, offset, activeMask, 4);
+        // Finished rows keep their sum untouched
+        x = _mm256_blendv_ps(x, _mm256_add_ps(x, _mm256_mul_ps(w, px)), activeMask);
+        y = _mm256_blendv_ps(y, _mm256_add_ps(y, _mm256_mul_ps(w, py)), activeMask);
+        z = _mm256_blendv_ps(z, _mm256_add_ps(z, _mm256_mul_ps(w, pz)), activeMask);
+      }
+
+      __m256i rows = _mm256_add_epi32(_mm256_set1_epi32(i), lanes);
+      __m256i own = _mm256_add_epi32(rows, _mm256_add_epi32(rows, rows));
+      __m256 ox = _mm256_i32gather_ps(coordinates, own, 4);
+      __m256 oy = _mm256_i32gather_ps(coordinates + 1, own, 4);
+      __m256 oz = _mm256_i32gather_ps(coordinates + 2, own, 4);
+      ox = _mm256_add_ps(ox, _mm256_mul_ps(lambdas, _mm256_sub_ps(x, ox)));
+      oy = _mm256_add_ps(oy, _mm256_mul_ps(lambdas, _mm256_sub_ps(y, oy)));
+      oz = _mm256_add_ps(oz, _mm256_mul_ps(lambdas, _mm256_sub_ps(z, oz)));
+
+      __m256 dx = _mm256_sub_ps(ox, _mm256_i32gather_ps(referenceCoordinates, own, 4));
+      __m256 dy = _mm256_sub_ps(oy, _mm256_i32gather_ps(referenceCoordinates + 1, own, 4));
+      __m256 dz = _mm256_sub_ps(oz, _mm256_i32gather_ps(referenceCoordinates + 2, own, 4));
+      __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+      alignas(32) float rx[8], ry[8], rz[8], rd[8];
+      _mm256_store_ps(rx, ox);
+      _mm256_store_ps(ry, oy);
+      _mm256_store_ps(rz, oz);
+      _mm256_store_ps(rd, d2);
+      for (int r = 0; r < 8; ++r)
+      {
+        out[i + r].x = rx[r];
+        out[i + r].y = ry[r];
+        out[i + r].z = rz[r];
+        displacement.sumSquared += rd[r];
+        displacement.maxSquared = std::max(displacement.maxSquared, rd[r]);
+      }
+    }
+    smoothRowsScalar(i, end, rowOffsets, columns, weights, in, lambda, out, reference, displacement);
+  }
+#endif
+
+  void smoothRows(bool useAvx2, int begin, int end, const int *rowOffsets, const int *columns, const float *weights, const glm::vec3 *in, float lambda, glm::vec3 *out, const glm::vec3 *reference, StepDisplacement &displacement)
+  {
+#ifdef LAPLACIAN_HAVE_AVX2
+    if (useAvx2)
+    {
+      smoothRowsAvx2(begin, end, rowOffsets, columns, weights, in, lambda, out, reference, displacement);
+      return;
+    }
+#endif
+    smoothRowsScalar(begin, end, rowOffsets, columns, weights, in, lambda, out, reference, displacement);
+  }
+
+  // Smooth the listed rows into out[0 .. nRows-1], same arithmetic as smoothRowsScalar
+  void smoothListedRows(const int *rows, int nRows, const int *rowOffsets, const int *columns, const float *weights, const glm::vec3 *in, float lambda, glm::vec3 *out, StepDisplacement &displacement)
+  {
+    for (int r = 0; r < nRows; ++r)
+    {
+      int i = rows[r];
+      float x = 0.0f, y = 0.0f, z = 0.0f;
+      for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; ++k)
+      {
+        const glm::vec3 &p = in[columns[k]];
+        x = x + weights[k] * p.x;
+        y = y + weights[k] * p.y;
+        z = z + weights[k] * p.z;
+      }
+      out[r].x = in[i].x + lambda * (x - in[i].x);
+      out[r].y = in[i].y + lambda * (y - in[i].y);
+      out[r].z = in[i].z + lambda * (z - in[i].z);
+      float d2 = squaredLength(out[r].x - in[i].x, out[r].y - in[i].y, out[r].z - in[i].z);
+      displacement.sumSquared += d2;
+      displacement.maxSquared = std::max(displacement.maxSquared, d2);
+    }
+  }
+
+  // Add up per-tile statistics in tile order, so the sum does not depend on the thread count
+  StepDisplacement combine(const std::vector<StepDisplacement> &tiles)
+  {
+    StepDisplacement total = {0.0, 0.0f};
+    for (const StepDisplacement &tile : tiles)
+    {
+      total.sumSquared += tile.sumSquared;
+      total.maxSquared = std::max(total.maxSquared, tile.maxSquared);
+    }
+    return total;
+  }
+}
+
+LaplacianOperator::LaplacianOperator() : useAvx2(false)
+{
+#ifdef LAPLACIAN_HAVE_AVX2
+  useAvx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+void LaplacianOperator::build(int nVertices, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency)
+{
+  entryCornerOffsets.clear();
+  entryCorners.clear();
+  cornerCotangents.clear();
+  referencePositions.clear();
+
+  // Count the distinct neighbors of every row, then fill the rows at their prefix offsets
+  rowOffsets.assign(nVertices + 1, 0);
+  parallelFor(nVertices, minRange, [&](int begin, int end)
+  {
+    std::vector<int> corners;
+    for (int v = begin; v < end; ++v)
+    {
+      collectRow(v, triangles, adjacencyBegin, adjacencyEnd, adjacency, corners);
+      rowOffsets[v + 1] = corners.empty() ? 1 : (int)(std::unique(corners.begin(), corners.end()) - corners.begin());
+    }
+  });
+  for (int v = 0; v < nVertices; ++v)
+  {
+    rowOffsets[v + 1] += rowOffsets[v];
+  }
+
+  columns.resize(rowOffsets[nVertices]);
+  weights.resize(rowOffsets[nVertices]);
+  degrees.resize(nVertices);
+  parallelFor(nVertices, minRange, [&](int begin, int end)
+  {
+    std::vector<int> corners;
+    for (int v = begin; v < end; ++v)
+    {
+      int k = rowOffsets[v];
+      collectRow(v, triangles, adjacencyBegin, adjacencyEnd, adjacency, corners);
+      if (corners.empty())
+      {
+        columns[k] = v;
+        weights[k] = 1.0f;
+        degrees[v] = 1.0f;
+        continue;
+      }
+      float denominator = (float)(2 * (adjacencyEnd[v] - adjacencyBegin[v]));
+      degrees[v] = denominator;
+      for (size_t j = 0; j < corners.size();)
+      {
+        size_t run = j;
+        while (run < corners.size() && corners[run] == corners[j])
+        {
+          ++run;
+        }
+        columns[k] = corners[j];
+        weights[k] = (float)(run - j) / denominator;
+        ++k;
+        j = run;
+      }
+    }
+  });
+
+  // Range of columns read by the rows of every tile, including the diagonal
+  int nTiles = (nVertices + tileRows - 1) / tileRows;
+  tileLow.assign(nTiles, 0);
+  tileHigh.assign(nTiles, 0);
+  parallelFor(nTiles, 1, [&](int first, int last)
+  {
+    for (int t = first; t < last; ++t)
+    {
+      int begin = t * tileRows, end = std::min(nVertices, begin + tileRows);
+      int low = begin, high = end - 1;
+      for (int k = rowOffsets[begin]; k < rowOffsets[end]; ++k)
+      {
+        low = std::min(low, columns[k]);
+        high = std::max(high, columns[k]);
+      }
+      tileLow[t] = low;
+      tileHigh[t] = high;
+    }
+  });
+}
+
+int LaplacianOperator::findEntry(int row, int column) const
+{
+  const int *first = columns.data() + rowOffsets[row];
+  const int *last = columns.data() + rowOffsets[row + 1];
+  const int *it = std::lower_bound(first, last, column);
+  return it != last && *it == column ? (int)(it - columns.data()) : -1;
+}
+
+void LaplacianOperator::setupCotangents(int nTriangles, const int *triangles)
+{
+  // Corner c of a triangle is opposite the edge between its other two corners, which has an
+  // entry in both of their rows. Counting sort of the corners by entry.
+  entryCornerOffsets.assign(columns.size() + 1, 0);
+  std::vector<int> cornerEntries(6 * (size_t)nTriangles, -1);
+  for (int f = 0; f < nTriangles; ++f)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      int u = triangles[3 * f + (c + 1) % 3], v = triangles[3 * f + (c + 2) % 3];
+      if (u == v)
+      {
+        continue;
+      }
+      cornerEntries[6 * f + 2 * c] = findEntry(u, v);
+      cornerEntries[6 * f + 2 * c + 1] = findEntry(v, u);
+      ++entryCornerOffsets[cornerEntries[6 * f + 2 * c] + 1];
+      ++entryCornerOffsets[cornerEntries[6 * f + 2 * c + 1] + 1];
+    }
+  }
+  for (size_t k = 0; k < columns.size(); ++k)
+  {
+    entryCornerOffsets[k + 1] += entryCornerOffsets[k];
+  }
+  entryCorners.resize(entryCornerOffsets.back());
+  std::vector<int> fill(entryCornerOffsets.begin(), entryCornerOffsets.end() - 1);
+  for (int f = 0; f < nTriangles; ++f)
+  {
+    for (int i = 0; i < 6; ++i)
+    {
+      if (cornerEntries[6 * f + i] >= 0)
+      {
+        entryCorners[fill[cornerEntries[6 * f + i]]++] = 3 * f + i / 2;
+      }
+    }
+  }
+  cornerCotangents.assign(3 * (size_t)nTriangles, 0.0f);
+}
+
+void LaplacianOperator::updateCotangentWeights(int nTriangles, const int *triangles, const glm::vec3 *positions, float tolerance)
+{
+  int n = size();
+  bool first = referencePositions.empty() && n > 0;
+  if (first)
+  {
+    setupCotangents(nTriangles, triangles);
+    referencePositions.assign(positions, positions + n);
+    moved.assign(n, 1);
+  }
+  else
+  {
+    float tolerance2 = tolerance * tolerance;
+    parallelFor(n, minRange, [&](int begin, int end)
+    {
+      for (int v = begin; v < end; ++v)
+      {
+        glm::vec3 d = positions[v] - referencePositions[v];
+        moved[v] = glm::dot(d, d) > tolerance2;
+        if (moved[v])
+        {
+          referencePositions[v] = positions[v];
+        }
+      }
+    });
+  }
+
+  // Cotangents of the corners of every triangle with a moved vertex, straight-line arithmetic
+  parallelFor(nTriangles, minRange, [&](int begin, int end)
+  {
+    for (int f = begin; f < end; ++f)
+    {
+      const int *t = triangles + 3 * f;
+      if (!(moved[t[0]] | moved[t[1]] | moved[t[2]]))
+      {
+        continue;
+      }
+      glm::vec3 p0 = referencePositions[t[0]], p1 = referencePositions[t[1]], p2 = referencePositions[t[2]];
+      glm::vec3 e0 = p2 - p1, e1 = p0 - p2, e2 = p1 - p0;
+      // |cross| is twice the area for all three corners, cot = dot / |cross|
+      float area2 = glm::length(glm::cross(e1, e2));
+      float inverse = area2 > 0.0f ? 1.0f / area2 : 0.0f;
+      cornerCotangents[3 * f] = std::max(0.0f, -glm::dot(e1, e2) * inverse);
+      cornerCotangents[3 * f + 1] = std::max(0.0f, -glm::dot(e2, e0) * inverse);
+      cornerCotangents[3 * f + 2] = std::max(0.0f, -glm::dot(e0, e1) * inverse);
+    }
+  });
+
+  // Rows read the corners of the triangles around their vertex, whose vertices are the row's
+  // vertex and its columns
+  parallelFor(n, minRange, [&](int begin, int end)
+  {
+    for (int i = begin; i < end; ++i)
+    {
+      bool dirty = moved[i] != 0;
+      for (int k = rowOffsets[i]; k < rowOffsets[i + 1] && !dirty; ++k)
+      {
+        dirty = moved[columns[k]] != 0;
+      }
+      if (!dirty)
+      {
+        continue;
+      }
+      float sum = 0.0f;
+      for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; ++k)
+      {
+        float w = 0.0f;
+        for (int m = entryCornerOffsets[k]; m < entryCornerOffsets[k + 1]; ++m)
+        {
+          w += 0.5f * cornerCotangents[entryCorners[m]];
+        }
+        weights[k] = w;
+        sum += w;
+      }
+      int length = rowOffsets[i + 1] - rowOffsets[i];
+      for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; ++k)
+      {
+        // Rows whose cotangents all vanish fall back to equal weights
+        weights[k] = sum > 0.0f ? weights[k] / sum : 1.0f / length;
+      }
+      degrees[i] = sum > 0.0f ? sum : 1.0f;
+    }
+  });
+}
+
+StepDisplacement LaplacianOperator::smooth(const glm::vec3 *in, float lambda, glm::vec3 *out) const
+{
+  return smoothFrom(in, lambda, out, in);
+}
+
+StepDisplacement LaplacianOperator::smoothFrom(const glm::vec3 *in, float lambda, glm::vec3 *out, const glm::vec3 *reference) const
+{
+  int nTiles = tileLow.size();
+  std::vector<StepDisplacement> tiles(nTiles);
+  parallelFor(nTiles, std::max(1, minRange / tileRows), [&](int first, int last)
+  {
+    for (int t = first; t < last; ++t)
+    {
+      StepDisplacement displacement = {0.0, 0.0f};
+      smoothRows(useAvx2, t * tileRows, std::min(size(), (t + 1) * tileRows), rowOffsets.data(), columns.data(), weights.data(), in, lambda, out, reference, displacement);
+      tiles[t] = displacement;
+    }
+  });
+  return combine(tiles);
+}
+
+StepDisplacement LaplacianOperator::smoothSubset(const int *rows, int nRows, const glm::vec3 *in, float lambda, glm::vec3 *out) const
+{
+  // Fixed blocks of the row list, so the statistics are combined in the same order for any thread count
+  int nBlocks = (nRows + tileRows - 1) / tileRows;
+  std::vector<StepDisplacement> blocks(nBlocks);
+  parallelFor(nBlocks, std::max(1, minRange / tileRows), [&](int first, int last)
+  {
+    for (int b = first; b < last; ++b)
+    {
+      StepDisplacement displacement = {0.0, 0.0f};
+      int begin = b * tileRows;
+      smoothListedRows(rows + begin, std::min(nRows, begin + tileRows) - begin, rowOffsets.data(), columns.data(), weights.data(), in, lambda, out + begin, displacement);
+      blocks[b] = displacement;
+    }
+  });
+  return combine(blocks);
+}
+
+StepDisplacement LaplacianOperator::taubin(const glm::vec3 *in, float lambda, float mu, glm::vec3 *temp, glm::vec3 *out) const
+{
+  smooth(in, lambda, temp);
+  return smoothFrom(temp, mu, out, in);
+}
+
+StepDisplacement LaplacianOperator::taubinBlocked(const glm::vec3 *in, float lambda, float mu, glm::vec3 *temp, glm::vec3 *out) const
+{
+  int nTiles = tileLow.size();
+  std::vector<char> deferred(nTiles, 0);
+  std::vector<StepDisplacement> tiles(nTiles);
+  auto tileBegin = [&](int t) { return t * tileRows; };
+  auto tileEnd = [&](int t) { return std::min(size(), (t + 1) * tileRows); };
+  auto lambdaStep = [&](int t)
+  {
+    StepDisplacement ignored = {0.0, 0.0f};
+    smoothRows(useAvx2, tileBegin(t), tileEnd(t), rowOffsets.data(), columns.data(), weights.data(), in, lambda, temp, in, ignored);
+  };
+  auto muStep = [&](int t)
+  {
+    StepDisplacement displacement = {0.0, 0.0f};
+    smoothRows(useAvx2, tileBegin(t), tileEnd(t), rowOffsets.data(), columns.data(), weights.data(), temp, mu, out, in, displacement);
+    tiles[t] = displacement;
+  };
+
+  // Every thread runs a wavefront over its own tiles: the mu step of a tile follows as soon
+  // as the lambda step has covered all the rows it reads. Tiles reading lambda rows of
+  // another thread are deferred until all threads are done.
+  parallelFor(nTiles, std::max(1, minRange / tileRows), [&](int first, int last)
+  {
+    int rangeBegin = tileBegin(first), rangeEnd = tileEnd(last - 1);
+    int next = first;
+    for (int t = first; t < last; ++t)
+    {
+      lambdaStep(t);
+      for (; next <= t; ++next)
+      {
+        if (tileLow[next] < rangeBegin || tileHigh[next] >= rangeEnd)
+        {
+          deferred[next] = 1;
+        }
+        else if (tileHigh[next] < tileEnd(t) || t == last - 1)
+        {
+          muStep(next);
+        }
+        else
+        {
+          break;
+        }
+      }
+    }
+  });
+  parallelFor(nTiles, 1, [&](int first, int last)
+  {
+    for (int t = first; t < last; ++t)
+    {
+      if (deferred[t])
+      {
+        muStep(t);
+      }
+    }
+  });
+  return combine(tiles);
+}
@@ -0,0 +1,104 @@
+#ifndef LAPLACIAN_HPP
+#define LAPLACIAN_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Weights of the neighbors of a vertex in the Laplacian
+enum class LaplacianWeighting
+{
+  // every triangle around the vertex contributes its two other corners equally (umbrella operator)
+  Uniform,
+  // cotangents of the angles opposite each edge, which keep triangle shapes while smoothing
+  Cotangent
+};
+
+// Displacement of the vertices over one smoothing step
+struct StepDisplacement
+{
+  double sumSquared; // sum of |out[i] - in[i]|^2
+  float maxSquared;  // largest |out[i] - in[i]|^2
+};
+
+// Umbrella averaging operator of a triangle mesh as a sparse matrix in CSR form.
+// Row i holds the vertices sharing a triangle with i, columns sorted increasingly, and
+// weight (number of triangles around i containing j) / (2 * number of triangles around i),
+// so every row averages the other corners of the triangles around its vertex.
+// A vertex without triangles gets a single weight 1 on itself and never moves.
+// With D = diag(degree) (twice the triangle count, 1 for such vertices), D times the weights
+// is symmetric, which the implicit solver relies on.
+// Built once from the connectivity, then applied to any number of position arrays.
+// updateCotangentWeights switches the same sparsity pattern to cotangent weights.
+class LaplacianOperator
+{
+public:
+  LaplacianOperator();
+
+  // Build the operator. triangles holds 3 vertex indices per triangle, the triangles around
+  // vertex i are adjacency[adjacencyBegin[i]] .. adjacency[adjacencyEnd[i]-1].
+  void build(int nVertices, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency);
+
+  // Replace the weights by normalized cotangent weights: entry (i, j) gets the sum of
+  // max(0, cot) / 2 of the angles opposite edge ij, divided by the row sum, which becomes the
+  // degree. Cotangents are cached per triangle corner; on later calls only triangles with a
+  // corner that moved more than tolerance since its last recomputation are recomputed, and
+  // only the rows around them are renormalized. triangles must be the ones given to build.
+  void updateCotangentWeights(int nTriangles, const int *triangles, const glm::vec3 *positions, float tolerance);
+
+  int size() const { return rowOffsets.empty() ? 0 : (int)rowOffsets.size() - 1; }
+  int nonZeros() const { return columns.size(); }
+
+  // CSR arrays: the entries of row i are rowOffsets[i] .. rowOffsets[i+1]-1
+  const int *rowOffsetData() const { return rowOffsets.data(); }
+  const int *columnData() const { return columns.data(); }
+  const float *weightData() const { return weights.data(); }
+  const float *degreeData() const { return degrees.data(); }
+
+  // One umbrella smoothing step: out[i] = in[i] + lambda * (sum_j w_ij in[j] - in[i]).
+  // out must not alias in. Every row is summed in column order on both the scalar and the
+  // AVX2 path, so the result is the same for any CPU and thread count.
+  // The displacement is measured while writing out, without another pass.
+  StepDisplacement smooth(const glm::vec3 *in, float lambda, glm::vec3 *out) const;
+
+  // smooth() restricted to the listed rows: out[r] gets the new position of vertex rows[r],
+  // bit for bit the value smooth() computes for it. Costs O(entries of the listed rows).
+  StepDisplacement smoothSubset(const int *rows, int nRows, const glm::vec3 *in, float lambda, glm::vec3 *out) const;
+
+  // One Taubin step: a lambda step from in into temp, then a mu step from temp into out.
+  // None of the three arrays may alias. Returns the displacement from in to out.
+  StepDisplacement taubin(const glm::vec3 *in, float lambda, float mu, glm::vec3 *temp, glm::vec3 *out) const;
+
+  // Same result as taubin(), computed tile by tile so the mu step of a tile runs while its
+  // lambda results are still in cache. Works best when neighboring vertices have nearby
+  // indices; tiles with far-reaching rows fall back to a second pass.
+  StepDisplacement taubinBlocked(const glm::vec3 *in, float lambda, float mu, glm::vec3 *temp, glm::vec3 *out) const;
+
+private:
+  std::vector<int> rowOffsets;
+  std::vector<int> columns;
+  std::vector<float> weights;
+  std::vector<float> degrees;
+
+  // Cotangent mode: the corners opposite the edge of entry k are
+  // entryCorners[entryCornerOffsets[k]] .. entryCorners[entryCornerOffsets[k+1]-1] (3 * triangle + corner)
+  std::vector<int> entryCornerOffsets;
+  std::vector<int> entryCorners;
+  std::vector<float> cornerCotangents;
+  // Vertex positions the cached cotangents were computed from
+  std::vector<glm::vec3> referencePositions;
+  std::vector<char> moved;
+
+  // smooth() with the displacement measured from reference instead of in
+  StepDisplacement smoothFrom(const glm::vec3 *in, float lambda, glm::vec3 *out, const glm::vec3 *reference) const;
+
+  // Index of entry (row, column), -1 if absent
+  int findEntry(int row, int column) const;
+  void setupCotangents(int nTriangles, const int *triangles);
+
+  // Lowest and highest column read by the rows of each tile of the blocked Taubin step
+  std::vector<int> tileLow;
+  std::vector<int> tileHigh;
+  bool useAvx2;
+};
+
+#endif // LAPLACIAN_HPP
@@ -0,0 +1,59 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : bytes(nullptr), length(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const std::string &filename)
+{
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  length = st.st_size;
+  if (length == 0)
+  {
+    // mmap refuses empty mappings, an empty file is simply empty data
+    ::close(fd);
+    bytes = "";
+    return true;
+  }
+  void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+  {
+    length = 0;
+    return false;
+  }
+  madvise(p, length, MADV_SEQUENTIAL);
+  bytes = static_cast<const char *>(p);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (bytes != nullptr && length > 0)
+  {
+    munmap(const_cast<char *>(bytes), length);
+  }
+  bytes = nullptr;
+  length = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+
+  // Map the file, returns false if it cannot be opened or mapped
+  bool open(const std::string &filename);
+
+  // Unmap the file (also done by the destructor)
+  void close();
+
+  const char *data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+
+  const char *bytes;
+  size_t length;
+};
+
+#endif // MAPPED_FILE_HPP
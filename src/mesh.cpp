@@ -1,15 +1,22 @@
 #include "mesh.hpp"
 #include "viewer.hpp"
+#include "fairing.hpp"
+#include "clustering.hpp"
+#include "validation.hpp"
 #include <algorithm>
+#include <cmath>
 
 // Add a vertex to the mesh
 int Mesh::addVertex(const glm::vec3 &pos, const glm::vec3 &normal)
 {
-  Vertex vertex;
-  vertex.position = pos;
-  vertex.normal = normal;
-  vertices.push_back(vertex);
-  return vertices.size() - 1; // Return index of the added vertex
+  positions.push_back(pos);
+  normals.push_back(normal);
+  adjacencyBegin.push_back(adjacency.size());
+  adjacencyEnd.push_back(adjacency.size());
+  adjacencyLimit.push_back(adjacency.size());
+  vertexDeleted.push_back(0);
+  topologyChanged();
+  return positions.size() - 1; // Return index of the added vertex
 }
 
 // Add a triangle to the mesh
@@ -21,40 +28,186 @@ void Mesh::addTriangle(int vertexIndex1, int vertexIndex2, int vertexIndex3)
   triangle.vertices[2] = vertexIndex3;
   triangles.push_back(triangle);
   // Update adjacent triangles for each vertex
-  vertices[vertexIndex1].adjacentTriangles.push_back(triangles.size() - 1);
-  vertices[vertexIndex2].adjacentTriangles.push_back(triangles.size() - 1);
-  vertices[vertexIndex3].adjacentTriangles.push_back(triangles.size() - 1);
+  addAdjacentTriangle(vertexIndex1, triangles.size() - 1);
+  addAdjacentTriangle(vertexIndex2, triangles.size() - 1);
+  addAdjacentTriangle(vertexIndex3, triangles.size() - 1);
+  indexTriangle(triangles.size() - 1);
+  topologyChanged();
 }
 
-// Get neighboring vertices of a vertex
-std::vector<Vertex> Mesh::getNeighboringVertices(int vertexIndex)
+// Append a triangle to the adjacency list of a vertex
+void Mesh::addAdjacentTriangle(int vertexIndex, int triangleIndex)
 {
-  std::vector<Vertex> neighboringVertices;
-  for (int triangleIndex : vertices[vertexIndex].adjacentTriangles)
+  if (adjacencyEnd[vertexIndex] == adjacencyLimit[vertexIndex])
+  {
+    int count = adjacencyEnd[vertexIndex] - adjacencyBegin[vertexIndex];
+    int capacity = std::max(8, 2 * count);
+    if (adjacencyLimit[vertexIndex] == (int)adjacency.size())
+    {
+      // The list is the last one in the pool, grow it in place
+      adjacency.resize(adjacencyBegin[vertexIndex] + capacity);
+    }
+    else
+    {
+      // Move the list to the end of the pool, its old slots are left unused
+      int begin = adjacency.size();
+      adjacency.resize(begin + capacity);
+      std::copy(adjacency.begin() + adjacencyBegin[vertexIndex], adjacency.begin() + adjacencyEnd[vertexIndex], adjacency.begin() + begin);
+      adjacencyBegin[vertexIndex] = begin;
+      adjacencyEnd[vertexIndex] = begin + count;
+    }
+    adjacencyLimit[vertexIndex] = adjacencyBegin[vertexIndex] + capacity;
+  }
+  adjacency[adjacencyEnd[vertexIndex]++] = triangleIndex;
+}
+
+// Add the edges of a triangle to the edge index
+void Mesh::indexTriangle(int triangleIndex)
+{
+  const int *v = triangles[triangleIndex].vertices;
+  edges.insertTriangle(triangleIndex, v[0], v[1], v[2]);
+}
+
+// Remove the edges of a triangle from the edge index
+void Mesh::unindexTriangle(int triangleIndex)
+{
+  const int *v = triangles[triangleIndex].vertices;
+  edges.removeTriangle(triangleIndex, v[0], v[1], v[2]);
+}
+
+// Remove a triangle from the adjacency list of a vertex, keeping the order of the others
+void Mesh::removeAdjacentTriangle(int vertexIndex, int triangleIndex)
+{
+  std::vector<int>::iterator begin = adjacency.begin() + adjacencyBegin[vertexIndex];
+  std::vector<int>::iterator end = adjacency.begin() + adjacencyEnd[vertexIndex];
+  std::vector<int>::iterator it = std::find(begin, end, triangleIndex);
+  if (it != end)
+  {
+    std::copy(it + 1, end, it);
+    adjacencyEnd[vertexIndex]--;
+  }
+}
+
+// Replace the mesh contents with prebuilt arrays
+void Mesh::setMeshData(int nVertices, const glm::vec3 *positions, const glm::vec3 *normals, int nTriangles, const glm::ivec3 *triangles, const int *adjacencyOffsets, const int *adjacency)
+{
+  this->positions.assign(positions, positions + nVertices);
+  this->normals.assign(normals, normals + nVertices);
+  // The CSR arrays become the pool, every list fits exactly
+  this->adjacency.assign(adjacency, adjacency + adjacencyOffsets[nVertices]);
+  adjacencyBegin.assign(adjacencyOffsets, adjacencyOffsets + nVertices);
+  adjacencyEnd.assign(adjacencyOffsets + 1, adjacencyOffsets + nVertices + 1);
+  adjacencyLimit = adjacencyEnd;
+  this->triangles.resize(nTriangles);
+  for (int i = 0; i < nTriangles; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      this->triangles[i].vertices[j] = triangles[i][j];
+    }
+  }
+  vertexDeleted.assign(nVertices, 0);
+  deletedVertices = 0;
+  deletedTriangles = 0;
+  edges.build(&this->triangles.data()->vertices[0], nTriangles);
+  topologyChanged();
+}
+
+// Build the vertex-face map of a triangle list.
+// Two-pass counting sort: count the faces of every vertex, then fill a flat array.
+VertexFaceMap Mesh::buildVertexFaceMap(const std::vector<glm::ivec3> &triangles, int nVertices)
+{
+  VertexFaceMap vertexFaces;
+  std::vector<int> &offsets = vertexFaces.offsets;
+  offsets.assign(nVertices + 1, 0);
+
+  // Count the faces of every vertex, skipping out of range indices
+  for (const glm::ivec3 &triangle : triangles)
   {
-    for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
     {
-      int neighborVertexIndex = triangles[triangleIndex].vertices[i];
-      if (neighborVertexIndex != vertexIndex)
+      if (triangle[j] >= 0 && triangle[j] < nVertices)
       {
-        neighboringVertices.push_back(vertices[neighborVertexIndex]);
+        offsets[triangle[j] + 1]++;
       }
     }
   }
+  for (int i = 0; i < nVertices; ++i)
+  {
+    offsets[i + 1] += offsets[i];
+  }
+
+  // Scatter the face indices, faces are visited in order so every list ends up sorted
+  vertexFaces.faces.resize(offsets[nVertices]);
+  std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+  for (int i = 0; i < triangles.size(); ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      int v = triangles[i][j];
+      if (v >= 0 && v < nVertices)
+      {
+        vertexFaces.faces[fill[v]++] = i;
+      }
+    }
+  }
+
+  return vertexFaces;
+}
+
+// Replace the mesh contents with prebuilt arrays and a vertex-face map
+void Mesh::setMeshData(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals, const std::vector<glm::ivec3> &triangles, const VertexFaceMap &vertexFaces)
+{
+  setMeshData(positions.size(), positions.data(), normals.data(), triangles.size(), triangles.data(), vertexFaces.offsets.data(), vertexFaces.faces.data());
+}
+
+// Get neighboring vertices of a vertex
+std::vector<Vertex> Mesh::getNeighboringVertices(int vertexIndex)
+{
+  std::vector<Vertex> neighboringVertices;
+  for (int neighborVertexIndex : neighbors(vertexIndex))
+  {
+    Vertex neighbor;
+    neighbor.position = positions[neighborVertexIndex];
+    neighbor.normal = normals[neighborVertexIndex];
+    IndexRange range = adjacentTriangles(neighborVertexIndex);
+    neighbor.adjacentTriangles.assign(range.begin(), range.end());
+    neighboringVertices.push_back(neighbor);
+  }
   return neighboringVertices;
 }
 
 // Get neighboring triangles of a vertex
 std::vector<Triangle> Mesh::getNeighboringTriangles(int vertexIndex)
 {
+  IndexRange range = adjacentTriangles(vertexIndex);
   std::vector<Triangle> neighboringTriangles;
-  for (int triangleIndex : vertices[vertexIndex].adjacentTriangles)
+  neighboringTriangles.reserve(range.size());
+  for (int triangleIndex : range)
   {
     neighboringTriangles.push_back(triangles[triangleIndex]);
   }
   return neighboringTriangles;
 }
 
+// Recompute all vertex normals from the current positions
+void Mesh::computeNormals(NormalWeighting weighting)
+{
+  computeVertexNormals(positions.size(), positions.data(), triangles.size(), &triangles.data()->vertices[0], adjacencyBegin.data(), adjacencyEnd.data(), adjacency.data(), weighting, normals.data());
+}
+
+// Vertex clustering simplification
+void Mesh::clusterDecimate(int resolution)
+{
+  compact();
+  std::vector<glm::vec3> clusterPositions;
+  std::vector<glm::ivec3> clusterTriangles;
+  clusterVertices(positions.size(), positions.data(), triangles.size(), &triangles.data()->vertices[0], adjacencyBegin.data(), adjacencyEnd.data(), adjacency.data(), resolution, clusterPositions, clusterTriangles);
+  std::vector<glm::vec3> clusterNormals(clusterPositions.size());
+  setMeshData(clusterPositions, clusterNormals, clusterTriangles, buildVertexFaceMap(clusterTriangles, clusterPositions.size()));
+  computeNormals();
+}
+
 // Render the mesh using a rasterization API
 void Mesh::render()
 {
@@ -63,86 +216,232 @@ void Mesh::render()
   {
     return;
   }
-  glm::vec3 *verticesArray = new glm::vec3[vertices.size()];
-  glm::vec3 *normalsArray = new glm::vec3[vertices.size()];
-  glm::ivec3 *trianglesArray = new glm::ivec3[triangles.size()];
-  for (int i = 0; i < vertices.size(); ++i)
+  v.setVertexData(positions.size(), positions.data(), normals.data());
+  if (deletedTriangles == 0)
   {
-    verticesArray[i] = vertices[i].position;
-    normalsArray[i] = vertices[i].normal;
+    // Triangle is three ints like glm::ivec3, so upload the storage itself
+    v.setTriangles(triangles.size(), (const glm::ivec3 *)triangles.data());
   }
-  for (int i = 0; i < triangles.size(); ++i)
+  else
   {
-    trianglesArray[i] = glm::ivec3(triangles[i].vertices[0], triangles[i].vertices[1], triangles[i].vertices[2]);
+    std::vector<glm::ivec3> trianglesArray;
+    liveTriangles(trianglesArray);
+    v.setTriangles(trianglesArray.size(), trianglesArray.data());
   }
-  v.setVertices(vertices.size(), verticesArray);
-  v.setNormals(vertices.size(), normalsArray);
-  v.setTriangles(triangles.size(), trianglesArray);
   v.view();
 }
 
-// Smooth the mesh using the umbrella operator
-void Mesh::smoothMesh(float lambda, int iterations)
+void Mesh::publish(COL781::Viewer::Viewer &viewer)
 {
-  for (int it = 0; it < iterations; ++it)
+  if (publishedVersion == topologyVersion)
   {
-    std::vector<glm::vec3> newPositions(vertices.size());
+    viewer.publish(positions.size(), positions.data(), normals.data());
+    return;
+  }
+  std::vector<glm::ivec3> trianglesArray;
+  liveTriangles(trianglesArray);
+  viewer.publish(positions.size(), positions.data(), normals.data(), trianglesArray.size(), trianglesArray.data());
+  publishedVersion = topologyVersion;
+}
+
+void Mesh::liveTriangles(std::vector<glm::ivec3> &out) const
+{
+  out.clear();
+  out.reserve(triangles.size() - deletedTriangles);
+  for (int i = 0; i < triangles.size(); ++i)
+  {
+    if (!isDeletedTriangle(i))
+    {
+      out.push_back(glm::ivec3(triangles[i].vertices[0], triangles[i].vertices[1], triangles[i].vertices[2]));
+    }
+  }
+}
 
-    for (size_t i = 0; i < vertices.size(); ++i)
+// The Laplacian of the current connectivity, rebuilt after topology changes
+const LaplacianOperator &Mesh::laplacian() const
+{
+  if (laplacianVersion != topologyVersion)
+  {
+    laplacianOperator.build(positions.size(), &triangles.data()->vertices[0], adjacencyBegin.data(), adjacencyEnd.data(), adjacency.data());
+    laplacianVersion = topologyVersion;
+  }
+  if (laplacianWeighting == LaplacianWeighting::Cotangent)
+  {
+    laplacianOperator.updateCotangentWeights(triangles.size(), &triangles.data()->vertices[0], positions.data(), cotangentTolerance);
+  }
+  return laplacianOperator;
+}
+
+void Mesh::setLaplacianWeighting(LaplacianWeighting weighting, float tolerance)
+{
+  if (weighting != laplacianWeighting)
+  {
+    // The operator starts over from the uniform weights
+    laplacianVersion = 0;
+  }
+  laplacianWeighting = weighting;
+  cotangentTolerance = tolerance;
+}
+
+namespace
+{
+  // Per-vertex displacement of a step in the requested norm
+  float residualOf(const StepDisplacement &displacement, int nVertices, ResidualNorm norm)
+  {
+    if (norm == ResidualNorm::Max)
+    {
+      return std::sqrt(displacement.maxSquared);
+    }
+    return nVertices > 0 ? (float)std::sqrt(displacement.sumSquared / nVertices) : 0.0f;
+  }
+}
+
+// Smooth the mesh using the umbrella operator
+SmoothingResult Mesh::smoothMesh(float lambda, int iterations, float tolerance, ResidualNorm norm)
+{
+  // Repeated products with the cached operator, ping-ponging between the two position buffers.
+  // The kernel measures the displacement while writing, so the convergence test is free.
+  SmoothingResult result = {0, 0.0f};
+  smoothedPositions.resize(positions.size());
+  while (result.iterations < iterations)
+  {
+    StepDisplacement displacement = laplacian().smooth(positions.data(), lambda, smoothedPositions.data());
+    positions.swap(smoothedPositions);
+    ++result.iterations;
+    result.residual = residualOf(displacement, positions.size(), norm);
+    if (result.residual <= tolerance)
     {
-      glm::vec3 averagePosition(0.0f);
+      break;
+    }
+  }
+  return result;
+}
 
-      for (int j : vertices[i].adjacentTriangles)
+// Umbrella smoothing restricted to a shrinking frontier of moving vertices
+SmoothingResult Mesh::activeSmoothMesh(float lambda, int iterations, float epsilon, float tolerance, ResidualNorm norm)
+{
+  SmoothingResult result = {0, 0.0f};
+  int n = positions.size();
+  activeVertices.resize(n);
+  for (int i = 0; i < n; ++i)
+  {
+    activeVertices[i] = i;
+  }
+  activeQueued.assign(n, 0);
+  smoothedPositions.resize(n);
+  float epsilon2 = epsilon * epsilon;
+  while (result.iterations < iterations && !activeVertices.empty())
+  {
+    // New positions of the active vertices are computed from the old ones before any is written
+    const LaplacianOperator &op = laplacian();
+    StepDisplacement displacement = op.smoothSubset(activeVertices.data(), activeVertices.size(), positions.data(), lambda, smoothedPositions.data());
+
+    // Only the rows of a vertex that moved, or of one of its neighbors, can change next time
+    const int *rowOffsets = op.rowOffsetData();
+    const int *columns = op.columnData();
+    nextActiveVertices.clear();
+    for (size_t r = 0; r < activeVertices.size(); ++r)
+    {
+      int v = activeVertices[r];
+      glm::vec3 d = smoothedPositions[r] - positions[v];
+      positions[v] = smoothedPositions[r];
+      if (glm::dot(d, d) <= epsilon2)
+      {
+        continue;
+      }
+      if (!activeQueued[v])
       {
-        for (int k : triangles[j].vertices)
+        activeQueued[v] = 1;
+        nextActiveVertices.push_back(v);
+      }
+      for (int k = rowOffsets[v]; k < rowOffsets[v + 1]; ++k)
+      {
+        if (!activeQueued[columns[k]])
         {
-          if (k != i)
-          {
-            averagePosition += vertices[k].position;
-          }
+          activeQueued[columns[k]] = 1;
+          nextActiveVertices.push_back(columns[k]);
         }
       }
-
-      averagePosition /= vertices[i].adjacentTriangles.size() * 2;
-      glm::vec3 delta = averagePosition - vertices[i].position;
-      newPositions[i] = vertices[i].position + lambda * delta;
     }
+    // Visit the next frontier in index order, which keeps the reads close together
+    std::sort(nextActiveVertices.begin(), nextActiveVertices.end());
+    for (int v : nextActiveVertices)
+    {
+      activeQueued[v] = 0;
+    }
+    activeVertices.swap(nextActiveVertices);
 
-    for (size_t i = 0; i < vertices.size(); ++i)
+    // Inactive vertices do not move, so the statistics of the active ones cover the whole mesh
+    ++result.iterations;
+    result.residual = residualOf(displacement, n, norm);
+    if (result.residual <= tolerance)
     {
-      vertices[i].position = newPositions[i];
+      break;
     }
   }
+  return result;
 }
 
 // Perform Taubin smoothing on the mesh
-void Mesh::taubinSmoothMesh(float lambda, float nu, int iterations)
+SmoothingResult Mesh::taubinSmoothMesh(float lambda, float nu, int iterations, float tolerance, ResidualNorm norm, bool cacheBlocked)
 {
-  for (int it = 0; it < iterations; ++it)
+  // Lambda step into one scratch buffer, nu step into the other, which then becomes the positions
+  SmoothingResult result = {0, 0.0f};
+  smoothedPositions.resize(positions.size());
+  taubinPositions.resize(positions.size());
+  while (result.iterations < iterations)
   {
-    smoothMesh(lambda, 1);
-    smoothMesh(nu, 1);
+    const LaplacianOperator &op = laplacian();
+    StepDisplacement displacement;
+    if (cacheBlocked)
+    {
+      displacement = op.taubinBlocked(positions.data(), lambda, nu, taubinPositions.data(), smoothedPositions.data());
+    }
+    else
+    {
+      displacement = op.taubin(positions.data(), lambda, nu, taubinPositions.data(), smoothedPositions.data());
+    }
+    positions.swap(smoothedPositions);
+    ++result.iterations;
+    result.residual = residualOf(displacement, positions.size(), norm);
+    if (result.residual <= tolerance)
+    {
+      break;
+    }
   }
+  return result;
 }
 
-void Mesh::edgeFlip(int vertexIndex1, int vertexIndex2)
+// Implicit umbrella smoothing, one linear solve per step
+void Mesh::implicitSmoothMesh(float lambda, int steps, float tolerance, int maxIterations)
 {
-  int t1idx = -1, t2idx = -1;
-  for (int i = 0; i < triangles.size(); i++)
+  if (fairingVersion != topologyVersion || fairingDisplacement.size() != positions.size())
   {
-    if ((triangles[i].vertices[0] == vertexIndex1 && triangles[i].vertices[1] == vertexIndex2) || (triangles[i].vertices[0] == vertexIndex1 && triangles[i].vertices[2] == vertexIndex2) || (triangles[i].vertices[1] == vertexIndex1 && triangles[i].vertices[0] == vertexIndex2) || (triangles[i].vertices[1] == vertexIndex1 && triangles[i].vertices[2] == vertexIndex2) || (triangles[i].vertices[2] == vertexIndex1 && triangles[i].vertices[0] == vertexIndex2) || (triangles[i].vertices[2] == vertexIndex1 && triangles[i].vertices[1] == vertexIndex2))
+    fairingDisplacement.assign(positions.size(), glm::vec3(0.0f));
+    fairingVersion = topologyVersion;
+  }
+  smoothedPositions.resize(positions.size());
+  for (int step = 0; step < steps; ++step)
+  {
+    // Warm start: move by the displacement of the previous solve, which the next one shrinks only slightly
+    for (int i = 0; i < positions.size(); ++i)
     {
-      // triangle contains the edge
-      if (t1idx == -1)
-        t1idx = i;
-      else
-      {
-        t2idx = i;
-        break;
-      }
+      smoothedPositions[i] = positions[i] + fairingDisplacement[i];
+    }
+    solveImplicitFairing(laplacian(), positions.data(), lambda, maxIterations, tolerance, smoothedPositions.data());
+    for (int i = 0; i < positions.size(); ++i)
+    {
+      fairingDisplacement[i] = smoothedPositions[i] - positions[i];
     }
+    positions.swap(smoothedPositions);
   }
-  // t1idx, t2idx are triangles sharing the edge
+}
+
+void Mesh::edgeFlip(int vertexIndex1, int vertexIndex2)
+{
+  // t1idx < t2idx are the triangles containing the edge
+  int t1idx = -1, t2idx = -1;
+  edges.find(vertexIndex1, vertexIndex2, t1idx, t2idx);
   if (t2idx == -1)
   {
     // edge is part of only one or no triangle
@@ -167,6 +466,9 @@ void Mesh::edgeFlip(int vertexIndex1, int vertexIndex2)
       break;
     }
   }
+  topologyChanged();
+  unindexTriangle(t1idx);
+  unindexTriangle(t2idx);
   if (clockwise)
   {
     triangles[t1idx].vertices[0] = v3;
@@ -185,54 +487,25 @@ void Mesh::edgeFlip(int vertexIndex1, int vertexIndex2)
     triangles[t2idx].vertices[1] = vertexIndex2;
     triangles[t2idx].vertices[2] = v4;
   }
-  // update adjacent triangles of v1,v2,v3,v4
-  std::vector<int> &temp = vertices[vertexIndex1].adjacentTriangles;
-  for (auto it = temp.begin(); it != temp.end();)
-  {
-    if (*it == t1idx)
-    {
-      it = temp.erase(it);
-      break;
-    }
-    else
-    {
-      ++it;
-    }
-  }
-  std::vector<int> &temp2 = vertices[vertexIndex2].adjacentTriangles;
-  for (auto it = temp2.begin(); it != temp2.end();)
+  // update adjacent triangles of v1,v2,v3,v4: t1 keeps v1 and loses v2, t2 keeps v2 and loses v1
+  removeAdjacentTriangle(vertexIndex2, t1idx);
+  removeAdjacentTriangle(vertexIndex1, t2idx);
+  addAdjacentTriangle(v3, t2idx);
+  addAdjacentTriangle(v4, t1idx);
+  indexTriangle(t1idx);
+  indexTriangle(t2idx);
+  if (validateEdits)
   {
-    if (*it == t2idx)
-    {
-      it = temp2.erase(it);
-      break;
-    }
-    else
-    {
-      ++it;
-    }
+    int touched[4] = {vertexIndex1, vertexIndex2, v3, v4};
+    checkEdit("edgeFlip", touched, 4);
   }
-  vertices[v3].adjacentTriangles.push_back(t2idx);
-  vertices[v4].adjacentTriangles.push_back(t1idx);
 }
 
 void Mesh::edgeSplit(int v1, int v2)
 {
+  // t1idx < t2idx are the triangles containing the edge
   int t1idx = -1, t2idx = -1;
-  for (int i = 0; i < triangles.size(); i++)
-  {
-    if ((triangles[i].vertices[0] == v1 && triangles[i].vertices[1] == v2) || (triangles[i].vertices[0] == v1 && triangles[i].vertices[2] == v2) || (triangles[i].vertices[1] == v1 && triangles[i].vertices[0] == v2) || (triangles[i].vertices[1] == v1 && triangles[i].vertices[2] == v2) || (triangles[i].vertices[2] == v1 && triangles[i].vertices[0] == v2) || (triangles[i].vertices[2] == v1 && triangles[i].vertices[1] == v2))
-    {
-      // triangle containts the edge
-      if (t1idx == -1)
-        t1idx = i;
-      else
-      {
-        t2idx = i;
-        break;
-      }
-    }
-  }
+  edges.find(v1, v2, t1idx, t2idx);
   if (t1idx == -1)
   {
     std::cout << v1 << ", " << v2 << " do not form an edge in the mesh" << std::endl;
@@ -256,7 +529,9 @@ void Mesh::edgeSplit(int v1, int v2)
         break;
       }
     }
-    int v4 = vertices.size();
+    topologyChanged();
+    unindexTriangle(t1idx);
+    int v4 = positions.size();
     int newt = triangles.size();
     Triangle newtdata;
     triangles.push_back(newtdata);
@@ -281,41 +556,34 @@ void Mesh::edgeSplit(int v1, int v2)
       triangles[newt].vertices[2] = v1;
     }
 
-    vertices[v3].adjacentTriangles.push_back(newt);
-    std::vector<int> &temp = vertices[v2].adjacentTriangles;
-    for (auto it = temp.begin(); it != temp.end();)
-    {
-      if (*it == t1idx)
-      {
-        it = temp.erase(it);
-        break;
-      }
-      else
-      {
-        ++it;
-      }
-    }
-    vertices[v2].adjacentTriangles.push_back(newt);
-    Vertex v4data;
-    vertices.push_back(v4data);
-    vertices[v4].position = (vertices[v1].position + vertices[v2].position) / 2.0f;
-    vertices[v4].adjacentTriangles = {newt, t1idx};
-    vertices[v4].normal = glm::vec3(0.0f);
+    addAdjacentTriangle(v3, newt);
+    removeAdjacentTriangle(v2, t1idx);
+    addAdjacentTriangle(v2, newt);
+    addVertex((positions[v1] + positions[v2]) / 2.0f, glm::vec3(0.0f));
+    addAdjacentTriangle(v4, newt);
+    addAdjacentTriangle(v4, t1idx);
+    indexTriangle(t1idx);
+    indexTriangle(newt);
     glm::vec3 v1p, v2p, v3p, v4p;
-    v1p = vertices[v1].position;
-    v2p = vertices[v2].position;
-    v3p = vertices[v3].position;
-    v4p = vertices[v4].position;
+    v1p = positions[v1];
+    v2p = positions[v2];
+    v3p = positions[v3];
+    v4p = positions[v4];
 
     if (clockwise)
     {
-      vertices[v4].normal += glm::cross((v3p - v4p), (v1p - v4p)) / (glm::length(v1p - v4p) * glm::length(v1p - v4p) * glm::length(v3p - v4p) * glm::length(v3p - v4p));
-      vertices[v4].normal += glm::cross((v2p - v4p), (v3p - v4p)) / (glm::length(v3p - v4p) * glm::length(v3p - v4p) * glm::length(v2p - v4p) * glm::length(v2p - v4p));
+      normals[v4] += glm::cross((v3p - v4p), (v1p - v4p)) / (glm::length(v1p - v4p) * glm::length(v1p - v4p) * glm::length(v3p - v4p) * glm::length(v3p - v4p));
+      normals[v4] += glm::cross((v2p - v4p), (v3p - v4p)) / (glm::length(v3p - v4p) * glm::length(v3p - v4p) * glm::length(v2p - v4p) * glm::length(v2p - v4p));
     }
     else
     {
-      vertices[v4].normal += glm::cross((v1p - v4p), (v3p - v4p)) / (glm::length(v1p - v4p) * glm::length(v1p - v4p) * glm::length(v3p - v4p) * glm::length(v3p - v4p));
-      vertices[v4].normal += glm::cross((v3p - v4p), (v2p - v4p)) / (glm::length(v3p - v4p) * glm::length(v3p - v4p) * glm::length(v2p - v4p) * glm::length(v2p - v4p));
+      normals[v4] += glm::cross((v1p - v4p), (v3p - v4p)) / (glm::length(v1p - v4p) * glm::length(v1p - v4p) * glm::length(v3p - v4p) * glm::length(v3p - v4p));
+      normals[v4] += glm::cross((v3p - v4p), (v2p - v4p)) / (glm::length(v3p - v4p) * glm::length(v3p - v4p) * glm::length(v2p - v4p) * glm::length(v2p - v4p));
+    }
+    if (validateEdits)
+    {
+      int touched[4] = {v1, v2, v3, v4};
+      checkEdit("edgeSplit", touched, 4);
     }
   }
   else
@@ -339,7 +607,10 @@ void Mesh::edgeSplit(int v1, int v2)
         break;
       }
     }
-    int v5 = vertices.size();
+    topologyChanged();
+    unindexTriangle(t1idx);
+    unindexTriangle(t2idx);
+    int v5 = positions.size();
     int newt1 = triangles.size();
     int newt2 = newt1 + 1;
     Triangle newt1data, newt2data;
@@ -383,61 +654,46 @@ void Mesh::edgeSplit(int v1, int v2)
       triangles[newt2].vertices[2] = v1;
     }
 
-    vertices[v3].adjacentTriangles.push_back(newt1);
-    vertices[v4].adjacentTriangles.push_back(newt2);
-    std::vector<int> &temp = vertices[v2].adjacentTriangles;
-    for (auto it = temp.begin(); it != temp.end();)
-    {
-      if (*it == t1idx)
-      {
-        it = temp.erase(it);
-        break;
-      }
-      else
-      {
-        ++it;
-      }
-    }
-    std::vector<int> &temp2 = vertices[v1].adjacentTriangles;
-    for (auto it = temp2.begin(); it != temp2.end();)
-    {
-      if (*it == t2idx)
-      {
-        it = temp2.erase(it);
-        break;
-      }
-      else
-      {
-        ++it;
-      }
-    }
-    vertices[v2].adjacentTriangles.push_back(newt1);
-    vertices[v1].adjacentTriangles.push_back(newt2);
-    Vertex v5data;
-    vertices.push_back(v5data);
-    vertices[v5].position = (vertices[v1].position + vertices[v2].position) / 2.0f;
-    vertices[v5].adjacentTriangles = {newt1, t1idx, newt2, t2idx};
-    vertices[v5].normal = glm::vec3(0.0f);
+    addAdjacentTriangle(v3, newt1);
+    addAdjacentTriangle(v4, newt2);
+    removeAdjacentTriangle(v2, t1idx);
+    removeAdjacentTriangle(v1, t2idx);
+    addAdjacentTriangle(v2, newt1);
+    addAdjacentTriangle(v1, newt2);
+    addVertex((positions[v1] + positions[v2]) / 2.0f, glm::vec3(0.0f));
+    addAdjacentTriangle(v5, newt1);
+    addAdjacentTriangle(v5, t1idx);
+    addAdjacentTriangle(v5, newt2);
+    addAdjacentTriangle(v5, t2idx);
+    indexTriangle(t1idx);
+    indexTriangle(t2idx);
+    indexTriangle(newt1);
+    indexTriangle(newt2);
     glm::vec3 v1p, v2p, v3p, v4p, v5p;
-    v1p = vertices[v1].position;
-    v2p = vertices[v2].position;
-    v3p = vertices[v3].position;
-    v4p = vertices[v4].position;
-    v5p = vertices[v5].position;
+    v1p = positions[v1];
+    v2p = positions[v2];
+    v3p = positions[v3];
+    v4p = positions[v4];
+    v5p = positions[v5];
 
     if (clockwise)
     {
-      vertices[v5].normal += glm::cross((v3p - v5p), (v1p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v3p - v5p) * glm::length(v3p - v5p));
-      vertices[v5].normal += glm::cross((v2p - v5p), (v3p - v5p)) / (glm::length(v3p - v5p) * glm::length(v3p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
-      vertices[v5].normal += glm::cross((v1p - v5p), (v4p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v4p - v5p) * glm::length(v4p - v5p));
-      vertices[v5].normal += glm::cross((v4p - v5p), (v2p - v5p)) / (glm::length(v4p - v5p) * glm::length(v4p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
+      normals[v5] += glm::cross((v3p - v5p), (v1p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v3p - v5p) * glm::length(v3p - v5p));
+      normals[v5] += glm::cross((v2p - v5p), (v3p - v5p)) / (glm::length(v3p - v5p) * glm::length(v3p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
+      normals[v5] += glm::cross((v1p - v5p), (v4p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v4p - v5p) * glm::length(v4p - v5p));
+      normals[v5] += glm::cross((v4p - v5p), (v2p - v5p)) / (glm::length(v4p - v5p) * glm::length(v4p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
     }
     else
     {
-      vertices[v5].normal += glm::cross((v1p - v5p), (v3p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v3p - v5p) * glm::length(v3p - v5p));
-      vertices[v5].normal += glm::cross((v3p - v5p), (v2p - v5p)) / (glm::length(v3p - v5p) * glm::length(v3p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
-      vertices[v5].normal += glm::cross((v4p - v5p), (v1p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v4p - v5p) * glm::length(v4p - v5p));
-      vertices[v5].normal += glm::cross((v2p - v5p), (v4p - v5p)) / (glm::length(v4p - v5p) * glm::length(v4p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
+      normals[v5] += glm::cross((v1p - v5p), (v3p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v3p - v5p) * glm::length(v3p - v5p));
+      normals[v5] += glm::cross((v3p - v5p), (v2p - v5p)) / (glm::length(v3p - v5p) * glm::length(v3p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
+      normals[v5] += glm::cross((v4p - v5p), (v1p - v5p)) / (glm::length(v1p - v5p) * glm::length(v1p - v5p) * glm::length(v4p - v5p) * glm::length(v4p - v5p));
+      normals[v5] += glm::cross((v2p - v5p), (v4p - v5p)) / (glm::length(v4p - v5p) * glm::length(v4p - v5p) * glm::length(v2p - v5p) * glm::length(v2p - v5p));
+    }
+    if (validateEdits)
+    {
+      int touched[5] = {v1, v2, v3, v4, v5};
+      checkEdit("edgeSplit", touched, 5);
     }
   }
 }
@@ -445,28 +701,13 @@ void Mesh::edgeSplit(int v1, int v2)
 bool Mesh::edgeExists(int vertexIndex1, int vertexIndex2)
 {
   // Check if the vertices are valid
-  if (vertexIndex1 < 0 || vertexIndex1 >= vertices.size() || vertexIndex2 < 0 || vertexIndex2 >= vertices.size())
+  if (vertexIndex1 < 0 || vertexIndex1 >= positions.size() || vertexIndex2 < 0 || vertexIndex2 >= positions.size())
   {
     std::cerr << "Invalid vertex index" << std::endl;
     return false;
   }
 
-  // Iterate over the adjacent triangles of the first vertex
-  for (int triangleIndex : vertices[vertexIndex1].adjacentTriangles)
-  {
-    // Check if the second vertex is part of the triangle
-    for (int i = 0; i < 3; i++)
-    {
-      if (triangles[triangleIndex].vertices[i] == vertexIndex2)
-      {
-        // An edge exists between the two vertices
-        return true;
-      }
-    }
-  }
-
-  // No edge exists between the two vertices
-  return false;
+  return edges.contains(vertexIndex1, vertexIndex2);
 }
 
 void Mesh::edgeCollapse(int vertexIndex1, int vertexIndex2)
@@ -477,49 +718,124 @@ void Mesh::edgeCollapse(int vertexIndex1, int vertexIndex2)
     std::cerr << "Edge does not exist between the two vertices" << std::endl;
     return;
   }
-  glm::vec3 updatedpos=(vertices[vertexIndex1].position+vertices[vertexIndex2].position)/2.0f;
-  vertices[vertexIndex1].position=(vertices[vertexIndex1].position+vertices[vertexIndex2].position)/2.0f;
-  vertices[vertexIndex1].normal=(vertices[vertexIndex1].normal+vertices[vertexIndex2].normal)/2.0f;
-  // Remove the second vertex
-  vertices.erase(vertices.begin() + vertexIndex2);
+  edgeCollapse(vertexIndex1, vertexIndex2, (positions[vertexIndex1] + positions[vertexIndex2]) / 2.0f);
+}
 
-  // Update the triangles
-  for (Triangle &triangle : triangles)
+void Mesh::edgeCollapse(int vertexIndex1, int vertexIndex2, const glm::vec3 &position)
+{
+  // t1idx < t2idx are the triangles containing the edge
+  int t1idx = -1, t2idx = -1;
+  if (vertexIndex1 == vertexIndex2 || !edges.find(vertexIndex1, vertexIndex2, t1idx, t2idx))
   {
-    for (int i = 0; i < 3; i++)
+    std::cerr << "Edge does not exist between the two vertices" << std::endl;
+    return;
+  }
+  positions[vertexIndex1] = position;
+  normals[vertexIndex1] = (normals[vertexIndex1] + normals[vertexIndex2]) / 2.0f;
+  topologyChanged();
+
+  // The triangles on the edge vanish: unlink them from their corners and leave them degenerate
+  int collapsed[2] = {t1idx, t2idx};
+  int touched[4] = {vertexIndex1, vertexIndex2, vertexIndex1, vertexIndex1};
+  for (int k = 0; k < 2; ++k)
+  {
+    int t = collapsed[k];
+    if (t < 0)
     {
-      if (triangle.vertices[i] == vertexIndex2)
-      {
-        // Replace the removed vertex with the remaining vertex
-        triangle.vertices[i] = vertexIndex1;
-      }
-      else if (triangle.vertices[i] > vertexIndex2)
+      continue;
+    }
+    for (int v : triangles[t].vertices)
+    {
+      if (v != vertexIndex1 && v != vertexIndex2)
       {
-        // Decrement the indices of the vertices that come after the removed vertex
-        triangle.vertices[i]--;
+        touched[2 + k] = v;
       }
     }
+    unindexTriangle(t);
+    for (int v : triangles[t].vertices)
+    {
+      removeAdjacentTriangle(v, t);
+    }
+    for (int &v : triangles[t].vertices)
+    {
+      v = vertexIndex1;
+    }
+    ++deletedTriangles;
   }
 
-  // Update the adjacent triangles of the remaining vertex
-  vertices[vertexIndex1].adjacentTriangles.clear();
-  for (int i = 0; i < triangles.size(); i++)
+  // The other triangles of the removed vertex move over to the remaining one
+  for (int k = adjacencyBegin[vertexIndex2]; k < adjacencyEnd[vertexIndex2]; ++k)
   {
-    for (int j = 0; j < 3; j++)
+    int t = adjacency[k];
+    unindexTriangle(t);
+    for (int &v : triangles[t].vertices)
     {
-      if (triangles[i].vertices[j] == vertexIndex1)
+      if (v == vertexIndex2)
       {
-        vertices[vertexIndex1].adjacentTriangles.push_back(i);
-        break;
+        v = vertexIndex1;
       }
     }
+    addAdjacentTriangle(vertexIndex1, t);
+    indexTriangle(t);
+  }
+  adjacencyEnd[vertexIndex2] = adjacencyBegin[vertexIndex2];
+  vertexDeleted[vertexIndex2] = 1;
+  ++deletedVertices;
+  if (validateEdits)
+  {
+    checkEdit("edgeCollapse", touched, 4);
+  }
+}
+
+void Mesh::checkEdit(const char *operation, const int *vertices, int nVertices)
+{
+  ValidationReport report;
+  validateLocal(*this, vertices, nVertices, 4, report);
+  if (!report.isValid())
+  {
+    ++editFailures;
+    std::cerr << operation << " left an invalid neighborhood around vertex " << vertices[0] << std::endl;
+    report.print(std::cerr);
+  }
+}
+
+// Drop the tombstones left by edgeCollapse
+void Mesh::compact()
+{
+  if (!hasDeletions())
+  {
+    return;
+  }
+  std::vector<int> remap(positions.size(), -1);
+  std::vector<glm::vec3> livePositions, liveNormals;
+  livePositions.reserve(positions.size() - deletedVertices);
+  liveNormals.reserve(positions.size() - deletedVertices);
+  for (int v = 0; v < positions.size(); ++v)
+  {
+    if (!vertexDeleted[v])
+    {
+      remap[v] = livePositions.size();
+      livePositions.push_back(positions[v]);
+      liveNormals.push_back(normals[v]);
+    }
+  }
+  std::vector<glm::ivec3> liveTriangles;
+  liveTriangles.reserve(triangles.size() - deletedTriangles);
+  for (int t = 0; t < triangles.size(); ++t)
+  {
+    if (!isDeletedTriangle(t))
+    {
+      const int *v = triangles[t].vertices;
+      liveTriangles.push_back(glm::ivec3(remap[v[0]], remap[v[1]], remap[v[2]]));
+    }
   }
+  setMeshData(livePositions, liveNormals, liveTriangles, buildVertexFaceMap(liveTriangles, livePositions.size()));
 }
 
 bool Mesh::isValid()
 {
   // check if triangle indices are valid
-  int n = vertices.size();
+  int n = positions.size();
   for (auto triangle : triangles)
   {
     for (int i = 0; i < 3; i++)
@@ -533,9 +849,9 @@ bool Mesh::isValid()
   }
   // check if adjacent triangle indices are valid
   n = triangles.size();
-  for (auto v : vertices)
+  for (int v = 0; v < positions.size(); v++)
   {
-    for (int i : v.adjacentTriangles)
+    for (int i : adjacentTriangles(v))
     {
       if (i < 0 || i >= n)
       {
@@ -545,10 +861,15 @@ bool Mesh::isValid()
     }
   }
 
-  // check if triangles are valid
-  for (auto triangle : triangles)
+  // check if triangles are valid, skipping the ones deleted by edgeCollapse
+  for (int t = 0; t < triangles.size(); t++)
   {
-    glm::vec3 v1 = vertices[triangle.vertices[0]].position, v2 = vertices[triangle.vertices[1]].position, v3 = vertices[triangle.vertices[2]].position;
+    if (isDeletedTriangle(t))
+    {
+      continue;
+    }
+    const Triangle &triangle = triangles[t];
+    glm::vec3 v1 = positions[triangle.vertices[0]], v2 = positions[triangle.vertices[1]], v3 = positions[triangle.vertices[2]];
     glm::vec3 angle = glm::cross(v2 - v1, v3 - v1);
     if (glm::all(glm::equal(angle, glm::vec3(0.0f))))
     {
@@ -558,46 +879,22 @@ bool Mesh::isValid()
   }
 
 
-  // check for no duplicate triangles
-  for (int i = 0; i < triangles.size(); i++)
+  // check for no duplicate triangles, whatever their corner order
+  std::vector<int> duplicates;
+  findDuplicateTriangles(triangles.size(), triangles.data(), true, duplicates);
+  if (!duplicates.empty())
   {
-    for (int j = i + 1; j < triangles.size(); j++)
-    {
-      if (triangles[i].vertices[0] == triangles[j].vertices[0] && triangles[i].vertices[1] == triangles[j].vertices[1] && triangles[i].vertices[2] == triangles[j].vertices[2])
-      {
-        return false;
-      }
-      if (triangles[i].vertices[0] == triangles[j].vertices[0] && triangles[i].vertices[1] == triangles[j].vertices[2] && triangles[i].vertices[2] == triangles[j].vertices[1])
-      {
-        return false;
-      }
-      if (triangles[i].vertices[0] == triangles[j].vertices[1] && triangles[i].vertices[1] == triangles[j].vertices[2] && triangles[i].vertices[2] == triangles[j].vertices[0])
-      {
-        return false;
-      }
-      if (triangles[i].vertices[0] == triangles[j].vertices[1] && triangles[i].vertices[1] == triangles[j].vertices[0] && triangles[i].vertices[2] == triangles[j].vertices[2])
-      {
-        return false;
-      }
-      if (triangles[i].vertices[0] == triangles[j].vertices[2] && triangles[i].vertices[1] == triangles[j].vertices[0] && triangles[i].vertices[2] == triangles[j].vertices[1])
-      {
-        return false;
-      }
-      if (triangles[i].vertices[0] == triangles[j].vertices[2] && triangles[i].vertices[1] == triangles[j].vertices[1] && triangles[i].vertices[2] == triangles[j].vertices[0])
-      {
-        return false;
-      }
-    }
+    return false;
   }
 
   // check for orientational consistency
-  for (int i = 0; i < vertices.size(); i++)
+  for (int i = 0; i < positions.size(); i++)
   {
-    for (int j : vertices[i].adjacentTriangles)
+    for (int j : adjacentTriangles(i))
     {
-      glm::vec3 v1 = vertices[triangles[j].vertices[0]].position, v2 = vertices[triangles[j].vertices[1]].position, v3 = vertices[triangles[j].vertices[2]].position;
+      glm::vec3 v1 = positions[triangles[j].vertices[0]], v2 = positions[triangles[j].vertices[1]], v3 = positions[triangles[j].vertices[2]];
       glm::vec3 angle = glm::cross(v2 - v1, v3 - v1);
-      if (glm::dot(angle, vertices[i].normal) < 0)
+      if (glm::dot(angle, normals[i]) < 0)
       {
         return false;
       }
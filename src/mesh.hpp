@@ -4,8 +4,19 @@
 #include <vector>
 #include <iostream>
 #include <glm/glm.hpp>
+#include "normals.hpp"
+#include "edge_index.hpp"
+#include "laplacian.hpp"
 
-// Define a structure for vertex
+namespace COL781
+{
+  namespace Viewer
+  {
+    class Viewer;
+  }
+}
+
+// Define a structure for vertex (a copy of one vertex, the mesh itself stores vertex data in separate arrays)
 struct Vertex
 {
   glm::vec3 position;
@@ -19,13 +30,204 @@ struct Triangle
   int vertices[3];
 };
 
+// Vertex to triangle adjacency in compressed sparse row form: the triangles of
+// vertex i are faces[offsets[i]] .. faces[offsets[i+1]-1], in increasing order
+struct VertexFaceMap
+{
+  std::vector<int> offsets;
+  std::vector<int> faces;
+};
+
+// Read-only view of a contiguous run of indices
+struct IndexRange
+{
+  const int *first;
+  const int *last;
+
+  const int *begin() const { return first; }
+  const int *end() const { return last; }
+  int size() const { return last - first; }
+  int operator[](int i) const { return first[i]; }
+};
+
+// Iterator over the distinct vertices sharing a triangle with a center vertex, in the order they
+// first appear in its adjacency list. Nothing is allocated: a vertex is skipped if an earlier
+// corner of the one-ring already produced it, which costs O(valence) per step.
+class NeighborIterator
+{
+public:
+  NeighborIterator(const Triangle *triangles, const int *first, const int *current, const int *last, int center)
+      : triangles(triangles), first(first), current(current), last(last), corner(0), center(center)
+  {
+    skipVisited();
+  }
+
+  int operator*() const { return triangles[*current].vertices[corner]; }
+
+  NeighborIterator &operator++()
+  {
+    advance();
+    skipVisited();
+    return *this;
+  }
+
+  bool operator==(const NeighborIterator &other) const { return current == other.current && corner == other.corner; }
+  bool operator!=(const NeighborIterator &other) const { return !(*this == other); }
+
+private:
+  const Triangle *triangles;
+  const int *first;
+  const int *current;
+  const int *last;
+  int corner;
+  int center;
+
+  void advance()
+  {
+    if (++corner == 3)
+    {
+      corner = 0;
+      ++current;
+    }
+  }
+
+  // True if the current corner is the center or was already produced
+  bool visited() const
+  {
+    int v = **this;
+    if (v == center)
+    {
+      return true;
+    }
+    for (const int *t = first; t != current; ++t)
+    {
+      const int *corners = triangles[*t].vertices;
+      if (corners[0] == v || corners[1] == v || corners[2] == v)
+      {
+        return true;
+      }
+    }
+    for (int i = 0; i < corner; ++i)
+    {
+      if (triangles[*current].vertices[i] == v)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void skipVisited()
+  {
+    while (current != last && visited())
+    {
+      advance();
+    }
+  }
+};
+
+// Range over the neighbors of a vertex, for use in range-based for loops
+struct NeighborRange
+{
+  NeighborIterator first;
+  NeighborIterator last;
+
+  NeighborIterator begin() const { return first; }
+  NeighborIterator end() const { return last; }
+};
+
+// How the displacement of one smoothing iteration is measured
+enum class ResidualNorm
+{
+  // largest vertex displacement
+  Max,
+  // root mean square of the vertex displacements
+  RMS
+};
+
+// Outcome of an iterative smoothing call
+struct SmoothingResult
+{
+  int iterations;  // iterations actually run
+  float residual;  // displacement of the last iteration
+};
+
 // Define a mesh class
 class Mesh
 {
 private:
-  std::vector<Vertex> vertices;
+  // Vertex attributes, one entry per vertex
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+
+  // Triangles around vertex i are adjacency[adjacencyBegin[i]] .. adjacency[adjacencyEnd[i]-1].
+  // Slots up to adjacencyLimit[i] are reserved for the list, a list that outgrows them is moved
+  // to the end of the pool.
+  std::vector<int> adjacencyBegin;
+  std::vector<int> adjacencyEnd;
+  std::vector<int> adjacencyLimit;
+  std::vector<int> adjacency;
+
   std::vector<Triangle> triangles;
 
+  // Tombstones left by edgeCollapse until compact(). A deleted vertex has no triangles, a deleted
+  // triangle keeps all three corners on the vertex it collapsed into, so loops over the arrays
+  // see an unreferenced vertex and a zero-area triangle and need no special case.
+  std::vector<char> vertexDeleted;
+  int deletedVertices = 0;
+  int deletedTriangles = 0;
+
+  // Scratch position buffers for smoothing, kept between calls so iterations do not reallocate
+  std::vector<glm::vec3> smoothedPositions;
+  std::vector<glm::vec3> taubinPositions;
+
+  // Frontier of active-set smoothing: the vertices updated by the current iteration, the ones
+  // queued for the next, and a flag per vertex marking it as queued
+  std::vector<int> activeVertices;
+  std::vector<int> nextActiveVertices;
+  std::vector<char> activeQueued;
+
+  // Triangles on every edge, kept up to date by all operations that change triangles
+  EdgeIndex edges;
+
+  // Incremented by every change of the vertex or triangle lists
+  unsigned topologyVersion = 1;
+
+  // Umbrella operator built on demand for the topology version it was built from
+  mutable LaplacianOperator laplacianOperator;
+  mutable unsigned laplacianVersion = 0;
+  LaplacianWeighting laplacianWeighting = LaplacianWeighting::Uniform;
+  float cotangentTolerance = 0.0f;
+
+  // Displacement of the last implicit smoothing step, the initial guess of the next one
+  std::vector<glm::vec3> fairingDisplacement;
+  unsigned fairingVersion = 0;
+
+  // Debug checks after edgeFlip, edgeSplit and edgeCollapse, and the number of edits that failed them
+  bool validateEdits = false;
+  int editFailures = 0;
+
+  // Topology version last sent by publish()
+  unsigned publishedVersion = 0;
+
+  void topologyChanged() { ++topologyVersion; }
+
+  // The triangles without the tombstones of edgeCollapse, as drawn by the viewer
+  void liveTriangles(std::vector<glm::ivec3> &out) const;
+
+  // Validate the vertices touched by an edit and the triangles around them, reporting on std::cerr
+  void checkEdit(const char *operation, const int *vertices, int nVertices);
+
+  // Add / remove the edges of a triangle to / from the edge index
+  void indexTriangle(int triangleIndex);
+  void unindexTriangle(int triangleIndex);
+
+  // Append a triangle to the adjacency list of a vertex
+  void addAdjacentTriangle(int vertexIndex, int triangleIndex);
+
+  // Remove a triangle from the adjacency list of a vertex, keeping the order of the others
+  void removeAdjacentTriangle(int vertexIndex, int triangleIndex);
+
 public:
   // Add a vertex to the mesh
   int addVertex(const glm::vec3 &pos, const glm::vec3 &normal);
@@ -33,20 +235,110 @@ public:
   // Add a triangle to the mesh
   void addTriangle(int vertexIndex1, int vertexIndex2, int vertexIndex3);
 
-  // Get neighboring vertices of a vertex
+  // Replace the mesh contents with prebuilt arrays, vertex adjacency given in CSR form
+  // (the triangles of vertex i are adjacency[adjacencyOffsets[i]] .. adjacency[adjacencyOffsets[i+1]-1])
+  void setMeshData(int nVertices, const glm::vec3 *positions, const glm::vec3 *normals, int nTriangles, const glm::ivec3 *triangles, const int *adjacencyOffsets, const int *adjacency);
+
+  // Build the vertex-face map of a triangle list with a two-pass counting sort
+  static VertexFaceMap buildVertexFaceMap(const std::vector<glm::ivec3> &triangles, int nVertices);
+
+  // Replace the mesh contents with prebuilt arrays and a vertex-face map
+  void setMeshData(const std::vector<glm::vec3> &positions, const std::vector<glm::vec3> &normals, const std::vector<glm::ivec3> &triangles, const VertexFaceMap &vertexFaces);
+
+  // Number of vertices and triangles
+  int numVertices() const { return positions.size(); }
+  int numTriangles() const { return triangles.size(); }
+
+  // Tombstones of edgeCollapse, counted in numVertices() and numTriangles() until compact()
+  bool isDeletedVertex(int vertexIndex) const { return vertexDeleted[vertexIndex] != 0; }
+  bool isDeletedTriangle(int triangleIndex) const
+  {
+    const int *v = triangles[triangleIndex].vertices;
+    return v[0] == v[1] && v[1] == v[2];
+  }
+  bool hasDeletions() const { return deletedVertices > 0 || deletedTriangles > 0; }
+
+  // Drop the deleted vertices and triangles and renumber the rest in order, O(V + T)
+  void compact();
+
+  // Dense attribute arrays with numVertices() entries
+  const glm::vec3 *positionData() const { return positions.data(); }
+  const glm::vec3 *normalData() const { return normals.data(); }
+
+  // Dense triangle array with numTriangles() entries
+  const Triangle *triangleData() const { return triangles.data(); }
+
+  // Attributes of a single vertex
+  const glm::vec3 &position(int vertexIndex) const { return positions[vertexIndex]; }
+  const glm::vec3 &normal(int vertexIndex) const { return normals[vertexIndex]; }
+  void setPosition(int vertexIndex, const glm::vec3 &pos) { positions[vertexIndex] = pos; }
+  void setNormal(int vertexIndex, const glm::vec3 &normal) { normals[vertexIndex] = normal; }
+
+  // Indices of the triangles around a vertex, without copying
+  IndexRange adjacentTriangles(int vertexIndex) const
+  {
+    IndexRange range = {adjacency.data() + adjacencyBegin[vertexIndex], adjacency.data() + adjacencyEnd[vertexIndex]};
+    return range;
+  }
+
+  // Indices of the distinct vertices sharing a triangle with a vertex, without allocating
+  NeighborRange neighbors(int vertexIndex) const
+  {
+    const int *first = adjacency.data() + adjacencyBegin[vertexIndex];
+    const int *last = adjacency.data() + adjacencyEnd[vertexIndex];
+    NeighborRange range = {NeighborIterator(triangles.data(), first, first, last, vertexIndex), NeighborIterator(triangles.data(), first, last, last, vertexIndex)};
+    return range;
+  }
+
+  // Copies of the neighboring vertices of a vertex, each listed once (prefer neighbors())
   std::vector<Vertex> getNeighboringVertices(int vertexIndex);
 
-  // Get neighboring triangles of a vertex
+  // Copies of the triangles around a vertex (prefer adjacentTriangles())
   std::vector<Triangle> getNeighboringTriangles(int vertexIndex);
 
+  // Sparse Laplacian of the current connectivity. Built on first use and reused until the
+  // topology changes. With cotangent weights, the weights of the triangles that moved more
+  // than the tolerance since they were last computed are brought up to date on every call.
+  const LaplacianOperator &laplacian() const;
+
+  // Weighting used by laplacian() and the smoothing functions (uniform by default)
+  void setLaplacianWeighting(LaplacianWeighting weighting, float tolerance = 0.0f);
+
+  // Recompute all vertex normals from the current positions
+  void computeNormals(NormalWeighting weighting = NormalWeighting::InverseEdgeLength);
+
+  // Replace the mesh by its vertex clustering simplification on a grid with resolution cells
+  // along the longest side of the bounding box (see clusterVertices), with new normals
+  void clusterDecimate(int resolution);
+
   // Render the mesh using a rasterization API (dummy implementation)
   void render();
 
-  // Smooth the mesh using the umbrella operator
-  void smoothMesh(float lambda, int iterations);
+  // Send the current positions and normals to a viewer whose view() runs on another thread,
+  // and the triangles too if the topology changed since the last call. Call it from the
+  // thread editing the mesh, e.g. after every smoothing iteration, to watch progress live.
+  // The mesh remembers one published topology, so use one viewer per mesh.
+  void publish(COL781::Viewer::Viewer &viewer);
+
+  // Smooth the mesh using the umbrella operator. Stops early once an iteration moves the
+  // vertices by at most tolerance in the given norm.
+  SmoothingResult smoothMesh(float lambda, int iterations, float tolerance = 0.0f, ResidualNorm norm = ResidualNorm::Max);
+
+  // smoothMesh that only updates the vertices still moving: after the first iteration, which
+  // updates all of them, a vertex is updated only if it or one of its neighbors moved more than
+  // epsilon in the previous iteration. With epsilon 0 the result equals smoothMesh; iterations
+  // stop early once no vertex is left. Cost per iteration is proportional to the active set.
+  SmoothingResult activeSmoothMesh(float lambda, int iterations, float epsilon, float tolerance = 0.0f, ResidualNorm norm = ResidualNorm::Max);
+
+  // Perform Taubin smoothing on the mesh, stopping early like smoothMesh (the residual is the
+  // displacement over a full lambda + nu iteration). The cache-blocked variant gives the same
+  // result and runs both half steps on one tile of vertices before moving to the next.
+  SmoothingResult taubinSmoothMesh(float lambda, float nu, int iterations, float tolerance = 0.0f, ResidualNorm norm = ResidualNorm::Max, bool cacheBlocked = true);
 
-  // Perform Taubin smoothing on the mesh
-  void taubinSmoothMesh(float lambda, float nu, int iterations);
+  // Implicit (backward Euler) umbrella smoothing: every step solves (I - lambda L) x = x0 with
+  // preconditioned conjugate gradient, warm-started from the previous step. One step with a
+  // large lambda removes noise that takes hundreds of explicit iterations.
+  void implicitSmoothMesh(float lambda, int steps = 1, float tolerance = 1e-5f, int maxIterations = 500);
 
   //perform edge flip operation on the mesh
   void edgeFlip(int vertexIndex1, int vertexIndex2);
@@ -57,11 +349,23 @@ public:
   //checks if edge exists between two vertices
   bool edgeExists(int vertexIndex1, int vertexIndex2);
   
-  //perform edge flip operation on the mesh
+  // Merge vertexIndex2 into vertexIndex1 at the midpoint of the edge in O(valence). The second
+  // vertex and the triangles on the edge are marked deleted, indices of the others stay valid
+  // until compact().
   void edgeCollapse(int vertexIndex1, int vertexIndex2);
 
+  // Same as edgeCollapse, placing the remaining vertex at position
+  void edgeCollapse(int vertexIndex1, int vertexIndex2, const glm::vec3 &position);
+
   //checks if mesh connectivity is valid or not
   bool isValid();
+
+  // Debug mode for the edge operations: after each edgeFlip, edgeSplit and edgeCollapse, check
+  // the vertices it touched and their one-rings (see validateLocal), in O(valence) per edit
+  void setEditValidation(bool enabled) { validateEdits = enabled; }
+
+  // Number of edits that failed the check since the mesh was created
+  int editValidationFailures() const { return editFailures; }
 };
 
 #endif // MESH_HPP
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "mesh_cache.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  // The last byte is the format version, bump it whenever the layout changes
+  const char cacheMagic[8] = {'A', '2', 'M', 'E', 'S', 'H', '\0', '\2'};
+
+  // Bytes hashed at each end of the source file
+  const size_t hashedBytes = 64 * 1024;
+
+  // Identifies the source file a cache was built from
+  struct SourceStamp
+  {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+  };
+
+  // Fixed-size header, followed by positions, normals, triangles, adjacency offsets and adjacency
+  struct CacheHeader
+  {
+    char magic[8];
+    SourceStamp source;
+    int32_t nVertices;
+    int32_t nTriangles;
+    int32_t nAdjacency;
+    int32_t padding;
+  };
+
+  uint64_t fnv1a(const char *data, size_t n, uint64_t hash)
+  {
+    for (size_t i = 0; i < n; ++i)
+    {
+      hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  bool stampSource(const std::string &filename, SourceStamp &stamp)
+  {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+    {
+      return false;
+    }
+    std::memset(&stamp, 0, sizeof(stamp));
+    stamp.size = st.st_size;
+    stamp.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    stamp.hash = 14695981039346656037ull;
+
+    FILE *file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+    {
+      return false;
+    }
+    // Small files are hashed whole, larger ones at both ends only
+    std::vector<char> buffer(2 * hashedBytes);
+    size_t n = std::fread(buffer.data(), 1, stamp.size <= 2 * hashedBytes ? buffer.size() : hashedBytes, file);
+    stamp.hash = fnv1a(buffer.data(), n, stamp.hash);
+    if (stamp.size > 2 * hashedBytes)
+    {
+      std::fseek(file, -(long)hashedBytes, SEEK_END);
+      n = std::fread(buffer.data(), 1, hashedBytes, file);
+      stamp.hash = fnv1a(buffer.data(), n, stamp.hash);
+    }
+    std::fclose(file);
+    return true;
+  }
+
+  size_t cacheSize(const CacheHeader &header)
+  {
+    return sizeof(CacheHeader) + 2 * sizeof(glm::vec3) * (size_t)header.nVertices + sizeof(glm::ivec3) * (size_t)header.nTriangles + sizeof(int) * ((size_t)header.nVertices + 1 + header.nAdjacency);
+  }
+}
+
+std::string meshCachePath(const std::string &objFilename)
+{
+  return objFilename + ".meshcache";
+}
+
+bool readMeshCache(const std::string &objFilename, Mesh &mesh)
+{
+  SourceStamp stamp;
+  if (!stampSource(objFilename, stamp))
+  {
+    return false;
+  }
+  MappedFile file;
+  if (!file.open(meshCachePath(objFilename)) || file.size() < sizeof(CacheHeader))
+  {
+    return false;
+  }
+  CacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(CacheHeader));
+  if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.source.size != stamp.size || header.source.mtime != stamp.mtime || header.source.hash != stamp.hash)
+  {
+    return false;
+  }
+  if (header.nVertices < 0 || header.nTriangles < 0 || header.nAdjacency < 0 || file.size() != cacheSize(header))
+  {
+    return false;
+  }
+
+  const char *p = file.data() + sizeof(CacheHeader);
+  const glm::vec3 *positions = reinterpret_cast<const glm::vec3 *>(p);
+  p += sizeof(glm::vec3) * header.nVertices;
+  const glm::vec3 *normals = reinterpret_cast<const glm::vec3 *>(p);
+  p += sizeof(glm::vec3) * header.nVertices;
+  const glm::ivec3 *triangles = reinterpret_cast<const glm::ivec3 *>(p);
+  p += sizeof(glm::ivec3) * header.nTriangles;
+  const int *adjacencyOffsets = reinterpret_cast<const int *>(p);
+  p += sizeof(int) * (header.nVertices + 1);
+  const int *adjacency = reinterpret_cast<const int *>(p);
+  if (adjacencyOffsets[0] != 0 || adjacencyOffsets[header.nVertices] != header.nAdjacency)
+  {
+    return false;
+  }
+  // setMeshData trusts the indices, so a corrupt cache must not get past here
+  for (int i = 0; i < header.nVertices; ++i)
+  {
+    if (adjacencyOffsets[i] > adjacencyOffsets[i + 1])
+    {
+      return false;
+    }
+  }
+  for (int i = 0; i < header.nTriangles; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      if (triangles[i][j] < 0 || triangles[i][j] >= header.nVertices)
+      {
+        return false;
+      }
+    }
+  }
+  for (int i = 0; i < header.nAdjacency; ++i)
+  {
+    if (adjacency[i] < 0 || adjacency[i] >= header.nTriangles)
+    {
+      return false;
+    }
+  }
+
+  mesh.setMeshData(header.nVertices, positions, normals, header.nTriangles, triangles, adjacencyOffsets, adjacency);
+  return true;
+}
+
+bool writeMeshCache(const std::string &objFilename, const std::vector<glm::vec3> &vertices, const std::vector<glm::vec3> &normals, const std::vector<glm::ivec3> &faces, const VertexFaceMap &vertexFaces)
+{
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  if (!stampSource(objFilename, header.source))
+  {
+    return false;
+  }
+  std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+  header.nVertices = vertices.size();
+  header.nTriangles = faces.size();
+  header.nAdjacency = vertexFaces.faces.size();
+
+  // Write to a temporary file and rename it, so readers never see a partial cache
+  std::string path = meshCachePath(objFilename);
+  std::string tmpPath = path + ".tmp" + std::to_string(getpid());
+  FILE *file = std::fopen(tmpPath.c_str(), "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  ok = ok && std::fwrite(vertices.data(), sizeof(glm::vec3), vertices.size(), file) == vertices.size();
+  ok = ok && std::fwrite(normals.data(), sizeof(glm::vec3), vertices.size(), file) == vertices.size();
+  ok = ok && std::fwrite(faces.data(), sizeof(glm::ivec3), faces.size(), file) == faces.size();
+  ok = ok && std::fwrite(vertexFaces.offsets.data(), sizeof(int), vertexFaces.offsets.size(), file) == vertexFaces.offsets.size();
+  ok = ok && std::fwrite(vertexFaces.faces.data(), sizeof(int), vertexFaces.faces.size(), file) == vertexFaces.faces.size();
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+  {
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,23 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+
+// Binary cache of a parsed OBJ file, stored next to it as <filename>.meshcache.
+// It holds positions, normals, triangles and the vertex-to-triangle adjacency so that later
+// loads only map the file and copy the arrays into the mesh. The cache is tied to the size,
+// modification time and a hash of the first and last 64 KiB of the source file.
+
+// Path of the cache file belonging to an OBJ file
+std::string meshCachePath(const std::string &objFilename);
+
+// Load the cached mesh of objFilename, returns false if there is no valid cache
+bool readMeshCache(const std::string &objFilename, Mesh &mesh);
+
+// Write the cache of objFilename, returns false if it could not be written
+bool writeMeshCache(const std::string &objFilename, const std::vector<glm::vec3> &vertices, const std::vector<glm::vec3> &normals, const std::vector<glm::ivec3> &faces, const VertexFaceMap &vertexFaces);
+
+#endif // MESH_CACHE_HPP
@@ -0,0 +1,38 @@
+#include "parser.hpp"
+#include "clustering.hpp"
+#include <chrono>
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <filename> resolution" << std::endl;
+        return 1;
+    }
+
+    std::string filename = argv[1];
+    int resolution;
+    std::istringstream(argv[2]) >> resolution;
+
+    // Cluster the parser's arrays directly, without building a mesh first
+    Parser p;
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::ivec3> faces;
+    p.parseOBJ(filename, vertices, normals, faces);
+    VertexFaceMap vertexFaces = p.createVertexFacesMap(faces, vertices.size());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<glm::vec3> clusterPositions;
+    std::vector<glm::ivec3> clusterTriangles;
+    clusterVertices(vertices.size(), vertices.data(), faces.size(), &faces.data()->x, vertexFaces.offsets.data(), vertexFaces.offsets.data() + 1, vertexFaces.faces.data(), resolution, clusterPositions, clusterTriangles);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << faces.size() << " -> " << clusterTriangles.size() << " triangles in " << seconds << " s" << std::endl;
+
+    Mesh mesh;
+    std::vector<glm::vec3> clusterNormals(clusterPositions.size());
+    mesh.setMeshData(clusterPositions, clusterNormals, clusterTriangles, Mesh::buildVertexFaceMap(clusterTriangles, clusterPositions.size()));
+    mesh.computeNormals();
+
+    mesh.render();
+
+    return 0;
+}
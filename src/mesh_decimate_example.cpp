@@ -0,0 +1,25 @@
+#include "parser.hpp"
+#include "decimation.hpp"
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <filename> triangles [maxError]" << std::endl;
+        return 1;
+    }
+
+    std::string filename = argv[1];
+    int triangles;
+    std::istringstream(argv[2]) >> triangles;
+    float maxError = argc > 3 ? std::stof(argv[3]) : std::numeric_limits<float>::max();
+
+    Parser p;
+
+    Mesh mesh=p.objToMesh(filename);
+    DecimationResult result = decimateQuadric(mesh, triangles, maxError);
+    std::cout << result.collapses << " collapses, " << result.triangles << " triangles, error " << result.error << std::endl;
+
+    mesh.render();
+
+    return 0;
+}
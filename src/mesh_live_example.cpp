@@ -0,0 +1,43 @@
+#include "parser.hpp"
+#include "viewer.hpp"
+#include <atomic>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <filename> lambda iterations" << std::endl;
+        return 1;
+    }
+
+    std::string filename = argv[1];
+    float lambda = std::stof(argv[2]);
+    int iterations;
+    std::istringstream(argv[3]) >> iterations;
+
+    Parser p;
+
+    Mesh mesh=p.objToMesh(filename);
+
+    // The window lives on this thread, the smoothing runs on another and publishes every iteration
+    COL781::Viewer::Viewer v;
+    if (!v.initialize("Mesh viewer", 640, 480)) {
+        return 1;
+    }
+    mesh.publish(v);
+
+    std::atomic<bool> closed(false);
+    std::thread worker([&]() {
+        for (int i = 0; i < iterations && !closed; ++i) {
+            mesh.smoothMesh(lambda, 1);
+            mesh.computeNormals();
+            mesh.publish(v);
+        }
+    });
+
+    v.view();
+    closed = true;
+    worker.join();
+
+    return 0;
+}
@@ -0,0 +1,29 @@
+#include "parser.hpp"
+#include "remesh.hpp"
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 3 && argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <filename> targetLength [iterations]" << std::endl;
+        return 1;
+    }
+
+    std::string filename = argv[1];
+    float targetLength;
+    std::istringstream(argv[2]) >> targetLength;
+    int iterations = argc > 3 ? std::stoi(argv[3]) : 10;
+
+    Parser p;
+
+    Mesh mesh=p.objToMesh(filename);
+    RemeshingStats stats = remeshIsotropic(mesh, targetLength, iterations);
+    std::cout << stats.iterations << " iterations" << std::endl;
+    std::cout << "split    " << stats.splits << " edges in " << stats.splitSeconds << " s" << std::endl;
+    std::cout << "collapse " << stats.collapses << " edges in " << stats.collapseSeconds << " s" << std::endl;
+    std::cout << "flip     " << stats.flips << " edges in " << stats.flipSeconds << " s" << std::endl;
+    std::cout << "relax    " << stats.relaxedVertices << " vertices in " << stats.relaxSeconds << " s" << std::endl;
+
+    mesh.render();
+
+    return 0;
+}
@@ -2,8 +2,8 @@
 
 int main(int argc, char* argv[]) {
 
-    if (argc != 4) {
-        std::cerr << "Usage: " << argv[0] << " <filename> lambda iterations" << std::endl;
+    if (argc != 4 && argc != 5) {
+        std::cerr << "Usage: " << argv[0] << " <filename> lambda iterations [tolerance]" << std::endl;
         return 1;
     }
 
@@ -11,11 +11,13 @@ int main(int argc, char* argv[]) {
     float lambda = std::stof(argv[2]);
     int iterations;
     std::istringstream(argv[3]) >> iterations;
+    float tolerance = argc > 4 ? std::stof(argv[4]) : 0.0f;
 
     Parser p;
 
     Mesh mesh=p.objToMesh(filename);  
-    mesh.smoothMesh(lambda, iterations);  
+    SmoothingResult result = mesh.smoothMesh(lambda, iterations, tolerance);
+    std::cout << result.iterations << " iterations, residual " << result.residual << std::endl;
 
     mesh.render();
 
@@ -2,8 +2,8 @@
 
 int main(int argc, char* argv[]) {
 
-    if (argc != 5) {
-        std::cerr << "Usage: " << argv[0] << " <filename> lambda nu iterations" << std::endl;
+    if (argc != 5 && argc != 6) {
+        std::cerr << "Usage: " << argv[0] << " <filename> lambda nu iterations [tolerance]" << std::endl;
         return 1;
     }
 
@@ -12,11 +12,13 @@ int main(int argc, char* argv[]) {
     float nu = std::stof(argv[3]);
     int iterations;
     std::istringstream(argv[4]) >> iterations;
+    float tolerance = argc > 5 ? std::stof(argv[5]) : 0.0f;
 
     Parser p;
 
     Mesh mesh=p.objToMesh(filename);  
-    mesh.taubinSmoothMesh(lambda, nu, iterations);  
+    SmoothingResult result = mesh.taubinSmoothMesh(lambda, nu, iterations, tolerance);
+    std::cout << result.iterations << " iterations, residual " << result.residual << std::endl;
 
     mesh.render();
 
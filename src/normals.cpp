@@ -0,0 +1,90 @@
+#include "normals.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+  // Triangles or vertices per parallel range
+  const int minRange = 4096;
+
+  // Contribution of each corner of triangles [begin, end) to its vertex normal.
+  // The weighting is switched outside the loops so every loop body is straight-line arithmetic.
+  void computeCornerNormals(int begin, int end, const glm::vec3 *positions, const int *triangles, NormalWeighting weighting, glm::vec3 *corners)
+  {
+    switch (weighting)
+    {
+    case NormalWeighting::InverseEdgeLength:
+      for (int f = begin; f < end; ++f)
+      {
+        const int *t = triangles + 3 * f;
+        for (int c = 0; c < 3; ++c)
+        {
+          glm::vec3 p = positions[t[c]];
+          glm::vec3 a = positions[t[(c + 1) % 3]] - p;
+          glm::vec3 b = positions[t[(c + 2) % 3]] - p;
+          float d = glm::dot(a, a) * glm::dot(b, b);
+          corners[3 * f + c] = d > 0.0f ? glm::cross(a, b) / d : glm::vec3(0.0f);
+        }
+      }
+      break;
+    case NormalWeighting::Area:
+      for (int f = begin; f < end; ++f)
+      {
+        const int *t = triangles + 3 * f;
+        glm::vec3 p0 = positions[t[0]], p1 = positions[t[1]], p2 = positions[t[2]];
+        glm::vec3 n = 0.5f * glm::cross(p1 - p0, p2 - p0);
+        corners[3 * f] = n;
+        corners[3 * f + 1] = n;
+        corners[3 * f + 2] = n;
+      }
+      break;
+    case NormalWeighting::Angle:
+      for (int f = begin; f < end; ++f)
+      {
+        const int *t = triangles + 3 * f;
+        glm::vec3 p0 = positions[t[0]], p1 = positions[t[1]], p2 = positions[t[2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float l = glm::length(n);
+        n = l > 0.0f ? n / l : glm::vec3(0.0f);
+        for (int c = 0; c < 3; ++c)
+        {
+          glm::vec3 p = positions[t[c]];
+          glm::vec3 a = positions[t[(c + 1) % 3]] - p;
+          glm::vec3 b = positions[t[(c + 2) % 3]] - p;
+          float d = std::sqrt(glm::dot(a, a) * glm::dot(b, b));
+          float cosine = d > 0.0f ? glm::clamp(glm::dot(a, b) / d, -1.0f, 1.0f) : 1.0f;
+          corners[3 * f + c] = std::acos(cosine) * n;
+        }
+      }
+      break;
+    }
+  }
+}
+
+void computeVertexNormals(int nVertices, const glm::vec3 *positions, int nTriangles, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency, NormalWeighting weighting, glm::vec3 *normals)
+{
+  std::vector<glm::vec3> corners(3 * (size_t)nTriangles);
+  parallelFor(nTriangles, minRange, [&](int begin, int end)
+  {
+    computeCornerNormals(begin, end, positions, triangles, weighting, corners.data());
+  });
+
+  // Every vertex gathers the corners it owns, so no two threads write the same normal
+  parallelFor(nVertices, minRange, [&](int begin, int end)
+  {
+    for (int v = begin; v < end; ++v)
+    {
+      glm::vec3 normal(0.0f);
+      for (int k = adjacencyBegin[v]; k < adjacencyEnd[v]; ++k)
+      {
+        const int *t = triangles + 3 * adjacency[k];
+        int c = t[0] == v ? 0 : (t[1] == v ? 1 : 2);
+        normal += corners[3 * adjacency[k] + c];
+      }
+      float l = glm::length(normal);
+      normals[v] = l > 0.0f ? normal / l : glm::vec3(0.0f);
+    }
+  });
+}
@@ -0,0 +1,25 @@
+#ifndef NORMALS_HPP
+#define NORMALS_HPP
+
+#include <glm/glm.hpp>
+
+// How the faces around a vertex contribute to its normal
+enum class NormalWeighting
+{
+  // cross(e1, e2) / (|e1|^2 |e2|^2) for the two edges e1, e2 leaving the vertex (the parser's original scheme)
+  InverseEdgeLength,
+  // face normal weighted by the face area
+  Area,
+  // unit face normal weighted by the angle of the face at the vertex
+  Angle
+};
+
+// Compute unit vertex normals of a triangle mesh.
+// triangles holds 3 vertex indices per triangle. The triangles around vertex i are
+// adjacency[adjacencyBegin[i]] .. adjacency[adjacencyEnd[i]-1], so a CSR offsets array
+// is passed as adjacencyBegin = offsets, adjacencyEnd = offsets + 1.
+// Works per face (3 corner contributions per triangle) and then gathers them per vertex,
+// both passes run in parallel without atomics. Vertices without faces get a zero normal.
+void computeVertexNormals(int nVertices, const glm::vec3 *positions, int nTriangles, const int *triangles, const int *adjacencyBegin, const int *adjacencyEnd, const int *adjacency, NormalWeighting weighting, glm::vec3 *normals);
+
+#endif // NORMALS_HPP
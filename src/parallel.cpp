@@ -0,0 +1,102 @@
+#include "parallel.hpp"
+
+namespace
+{
+  // Set on pool threads and while the calling thread runs a job, nested jobs run serially
+  thread_local bool insideJob = false;
+}
+
+ThreadPool &ThreadPool::instance()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool() : task(nullptr), nTasks(0), nextTask(0), pending(0), generation(0), stopping(false)
+{
+  for (int i = 1; i < workerCount(); ++i)
+  {
+    threads.push_back(std::thread(&ThreadPool::workerLoop, this));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &t : threads)
+  {
+    t.join();
+  }
+}
+
+void ThreadPool::run(int n, const std::function<void(int)> &fn)
+{
+  if (insideJob || threads.empty() || n <= 1)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      fn(i);
+    }
+    return;
+  }
+
+  // One job at a time, other callers wait their turn
+  std::lock_guard<std::mutex> runLock(runMutex);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    task = &fn;
+    nTasks = n;
+    nextTask = 0;
+    pending = n;
+    ++generation;
+  }
+  wake.notify_all();
+
+  insideJob = true;
+  drain();
+  insideJob = false;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return pending == 0; });
+  task = nullptr;
+}
+
+void ThreadPool::drain()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (task != nullptr && nextTask < nTasks)
+  {
+    int i = nextTask++;
+    const std::function<void(int)> *fn = task;
+    lock.unlock();
+    (*fn)(i);
+    lock.lock();
+    if (--pending == 0)
+    {
+      done.notify_all();
+    }
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  insideJob = true;
+  unsigned seen = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+      {
+        return;
+      }
+      seen = generation;
+    }
+    drain();
+  }
+}
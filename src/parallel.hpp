@@ -0,0 +1,147 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Number of threads used by the parallel loops (at least 1)
+inline int workerCount()
+{
+  unsigned n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : (int)n;
+}
+
+// Fixed set of workerCount() - 1 threads that sleep between jobs, so loops run many times
+// (smoothing iterations) do not pay for creating threads on every call.
+class ThreadPool
+{
+public:
+  // The process-wide pool, started on first use
+  static ThreadPool &instance();
+
+  ~ThreadPool();
+
+  // Call task(i) for every i in [0, nTasks) on the pool threads and the calling thread,
+  // and return when all calls are done. Calls from inside a task run serially.
+  void run(int nTasks, const std::function<void(int)> &task);
+
+private:
+  ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void workerLoop();
+  // Take and run tasks of the current job until none are left
+  void drain();
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::mutex runMutex;
+
+  // Current job, guarded by mutex
+  const std::function<void(int)> *task;
+  int nTasks;
+  int nextTask;
+  int pending;
+  unsigned generation;
+  bool stopping;
+};
+
+// Split [0, n) into contiguous ranges of at least minRange items, at most one per worker,
+// and call fn(begin, end) for every range on the thread pool. The ranges only depend on n,
+// minRange and workerCount(), never on scheduling.
+template <typename Function>
+void parallelFor(int n, int minRange, Function fn)
+{
+  if (n <= 0)
+  {
+    return;
+  }
+  int ranges = std::min(workerCount(), std::max(1, n / std::max(1, minRange)));
+  if (ranges == 1)
+  {
+    fn(0, n);
+    return;
+  }
+  ThreadPool::instance().run(ranges, [&](int r)
+  {
+    int begin = (int)((long long)n * r / ranges);
+    int end = (int)((long long)n * (r + 1) / ranges);
+    fn(begin, end);
+  });
+}
+
+// Sort keys in increasing order and move values along with them, keeping equal keys in their
+// original order. Least significant digit radix sort over 8-bit digits: each pass counts the
+// digits of fixed blocks of items in parallel, turns the counts into write offsets for every
+// (digit, block) pair and scatters the blocks in parallel, so the result does not depend on the
+// number of threads. Passes over a digit all keys share are skipped.
+template <typename Value>
+void radixSortByKey(std::vector<uint64_t> &keys, std::vector<Value> &values)
+{
+  const int digitBits = 8, nDigits = 1 << digitBits;
+  const int blockItems = 1 << 16;
+  int n = keys.size();
+  int nBlocks = (n + blockItems - 1) / blockItems;
+  std::vector<uint64_t> keysOut(n);
+  std::vector<Value> valuesOut(n);
+  std::vector<int> offsets((size_t)nBlocks * nDigits);
+  for (int shift = 0; shift < 64; shift += digitBits)
+  {
+    parallelFor(nBlocks, 1, [&](int firstBlock, int lastBlock)
+    {
+      for (int b = firstBlock; b < lastBlock; ++b)
+      {
+        int *count = &offsets[(size_t)b * nDigits];
+        std::fill(count, count + nDigits, 0);
+        for (int i = b * blockItems; i < std::min(n, (b + 1) * blockItems); ++i)
+        {
+          ++count[(keys[i] >> shift) & (nDigits - 1)];
+        }
+      }
+    });
+
+    int offset = 0;
+    bool shared = false;
+    for (int d = 0; d < nDigits && !shared; ++d)
+    {
+      int start = offset;
+      for (int b = 0; b < nBlocks; ++b)
+      {
+        int count = offsets[(size_t)b * nDigits + d];
+        offsets[(size_t)b * nDigits + d] = offset;
+        offset += count;
+      }
+      shared = offset - start == n;
+    }
+    if (shared)
+    {
+      continue;
+    }
+
+    parallelFor(nBlocks, 1, [&](int firstBlock, int lastBlock)
+    {
+      for (int b = firstBlock; b < lastBlock; ++b)
+      {
+        int *next = &offsets[(size_t)b * nDigits];
+        for (int i = b * blockItems; i < std::min(n, (b + 1) * blockItems); ++i)
+        {
+          int j = next[(keys[i] >> shift) & (nDigits - 1)]++;
+          keysOut[j] = keys[i];
+          valuesOut[j] = values[i];
+        }
+      }
+    });
+    keys.swap(keysOut);
+    values.swap(valuesOut);
+  }
+}
+
+#endif // PARALLEL_HPP
@@ -1,87 +1,227 @@
 #include "parser.hpp"
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "normals.hpp"
+#include "parallel.hpp"
 
-void Parser::parseOBJ(const std::string& filename, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::ivec3>& faces) {
-    std::ifstream file(filename);
-    if(!file.good())
-    {
-        std::cout<<"Cannot Open File "<<filename<<". Please check filename"<<std::endl;
+namespace {
+
+    inline bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
     }
-    std::string line;
 
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string token;
+    inline void skipBlanks(const char*& p, const char* end) {
+        while (p < end && isBlank(*p)) ++p;
+    }
 
-        if (!(iss >> token)) continue;
+    inline void skipLine(const char*& p, const char* end) {
+        while (p < end && *p != '\n') ++p;
+        if (p < end) ++p;
+    }
 
-        if (token == "v") {
-            float x, y, z;
-            if (iss >> x >> y >> z) {
-                vertices.push_back(glm::vec3(x, y, z));
+    // Parses a decimal float such as "-1.25e-3" without allocating, leaves p untouched on failure
+    bool parseFloat(const char*& p, const char* end, float& out) {
+        static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char* s = p;
+        skipBlanks(s, end);
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+')) {
+            negative = *s == '-';
+            ++s;
+        }
+        unsigned long long mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for (; s < end && *s >= '0' && *s <= '9'; ++s) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*s - '0');
+                if (mantissa != 0) ++digits;
+            } else {
+                ++exponent;
             }
-        } 
-        else if (token == "vn") {
-            float x, y, z;
-            if (iss >> x >> y >> z) {
-                normals.push_back(glm::vec3(x, y, z));
+        }
+        if (s < end && *s == '.') {
+            for (++s; s < end && *s >= '0' && *s <= '9'; ++s) {
+                any = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*s - '0');
+                    if (mantissa != 0) ++digits;
+                    --exponent;
+                }
+            }
+        }
+        if (!any) return false;
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            const char* e = s + 1;
+            bool negativeExp = false;
+            if (e < end && (*e == '-' || *e == '+')) {
+                negativeExp = *e == '-';
+                ++e;
             }
-        } 
-        else if (token == "f") {
-            glm::ivec3 face;
-            for (int i = 0; i < 3; ++i) {
-                std::string vertexData;
-                if (!(iss >> vertexData)) break;
-
-                std::istringstream viss(vertexData);
-                std::string vIndexStr, nIndexStr;
-                std::getline(viss, vIndexStr, '/');
-                face[i] = std::stoi(vIndexStr) - 1;
+            if (e < end && *e >= '0' && *e <= '9') {
+                int value = 0;
+                for (; e < end && *e >= '0' && *e <= '9'; ++e) {
+                    if (value < 10000) value = value * 10 + (*e - '0');
+                }
+                exponent += negativeExp ? -value : value;
+                s = e;
             }
-            faces.push_back(face);
         }
+        double value = (double)mantissa;
+        if (exponent < 0) {
+            value = -exponent <= 22 ? value / pow10[-exponent] : value / std::pow(10.0, -exponent);
+        } else if (exponent > 0) {
+            value = exponent <= 22 ? value * pow10[exponent] : value * std::pow(10.0, exponent);
+        }
+        out = (float)(negative ? -value : value);
+        p = s;
+        return true;
     }
-    int diff=vertices.size()-normals.size();
-    for (int i =0;i<diff;i++)
-    { 
-        normals.push_back(glm::vec3(0.0));
+
+    // Parses the vertex index of a face token ("7", "7/2", "7//3" or "7/2/3"), skipping the rest of the token.
+    // Relative (negative) indices are resolved against vertexCount and reported through relative.
+    bool parseFaceIndex(const char*& p, const char* end, int vertexCount, int& out, bool& relative) {
+        skipBlanks(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            ++p;
+        }
+        if (p >= end || *p < '0' || *p > '9') return false;
+        int value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            value = value * 10 + (*p - '0');
+        }
+        while (p < end && *p != '\n' && !isBlank(*p)) ++p;
+        out = negative ? vertexCount - value : value - 1;
+        relative = negative;
+        return true;
     }
-}
 
+    // Everything parsed from one newline-aligned slice of the file
+    struct ObjChunk {
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::ivec3> faces;
+        // face*3+corner of every relative index, stored relative to the start of the chunk
+        std::vector<int> relativeCorners;
+    };
 
-// Function to create a map of vertices to the indices of faces containing each vertex
-std::map<int, std::vector<int>> Parser::createVertexFacesMap(const std::vector<glm::ivec3>& faces) {
-    std::map<int, std::vector<int>> vertexFacesMap;
+    // Single pass over [p, end): one line at a time, no per-line allocation
+    void parseOBJRange(const char* p, const char* end, ObjChunk& chunk) {
+        while (p < end) {
+            skipBlanks(p, end);
+            if (p + 1 < end && p[0] == 'v' && isBlank(p[1])) {
+                p += 2;
+                glm::vec3 v;
+                if (parseFloat(p, end, v.x) && parseFloat(p, end, v.y) && parseFloat(p, end, v.z)) {
+                    chunk.vertices.push_back(v);
+                }
+            }
+            else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+                p += 3;
+                glm::vec3 n;
+                if (parseFloat(p, end, n.x) && parseFloat(p, end, n.y) && parseFloat(p, end, n.z)) {
+                    chunk.normals.push_back(n);
+                }
+            }
+            else if (p + 1 < end && p[0] == 'f' && isBlank(p[1])) {
+                p += 2;
+                int vertexCount = chunk.vertices.size();
+                glm::ivec3 face;
+                bool relative[3];
+                if (parseFaceIndex(p, end, vertexCount, face[0], relative[0]) && parseFaceIndex(p, end, vertexCount, face[1], relative[1]) && parseFaceIndex(p, end, vertexCount, face[2], relative[2])) {
+                    for (int i = 0; i < 3; ++i) {
+                        if (relative[i]) chunk.relativeCorners.push_back(chunk.faces.size() * 3 + i);
+                    }
+                    chunk.faces.push_back(face);
+                }
+            }
+            skipLine(p, end);
+        }
+    }
+
+    // Files smaller than this are parsed on the calling thread only
+    const size_t minChunkBytes = 1 << 20;
 
-    // Iterate through each face
-    for (int i = 0; i < faces.size(); ++i) {
-        const glm::ivec3& face = faces[i];
+}
+
+void Parser::parseOBJ(const std::string& filename, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::ivec3>& faces) {
+    MappedFile file;
+    if(!file.open(filename))
+    {
+        std::cout<<"Cannot Open File "<<filename<<". Please check filename"<<std::endl;
+    }
+    else
+    {
+        // Split the file at newline boundaries so that every chunk holds whole lines
+        const char* data = file.data();
+        size_t size = file.size();
+        int nChunks = std::max<size_t>(1, std::min<size_t>(workerCount(), size / minChunkBytes));
+        std::vector<const char*> bounds(nChunks + 1, data + size);
+        bounds[0] = data;
+        for (int c = 1; c < nChunks; ++c) {
+            const char* b = std::max(bounds[c - 1], data + size * c / nChunks);
+            while (b < data + size && b[-1] != '\n') ++b;
+            bounds[c] = b;
+        }
 
-        // Iterate through each vertex of the face
-        for (int j = 0; j < 3; ++j) {
-            int vertexIndex = face[j];
+        std::vector<ObjChunk> chunks(nChunks);
+        parallelFor(nChunks, 1, [&](int begin, int end) {
+            for (int c = begin; c < end; ++c) parseOBJRange(bounds[c], bounds[c + 1], chunks[c]);
+        });
 
-            // Check if the vertex index is already in the map
-            auto it = vertexFacesMap.find(vertexIndex);
+        // Prefix sums over the per-chunk counts give every chunk its slot in the output
+        std::vector<size_t> vertexOffset(nChunks + 1), normalOffset(nChunks + 1), faceOffset(nChunks + 1);
+        vertexOffset[0] = vertices.size();
+        normalOffset[0] = normals.size();
+        faceOffset[0] = faces.size();
+        for (int c = 0; c < nChunks; ++c) {
+            vertexOffset[c + 1] = vertexOffset[c] + chunks[c].vertices.size();
+            normalOffset[c + 1] = normalOffset[c] + chunks[c].normals.size();
+            faceOffset[c + 1] = faceOffset[c] + chunks[c].faces.size();
+        }
+        vertices.resize(vertexOffset[nChunks]);
+        normals.resize(normalOffset[nChunks]);
+        faces.resize(faceOffset[nChunks]);
 
-            // If not found, add a new entry for the vertex
-            if (it == vertexFacesMap.end()) {
-                vertexFacesMap[vertexIndex] = std::vector<int>{i};
-            } else {
-                // If found, append the face index to the existing list
-                it->second.push_back(i);
+        parallelFor(nChunks, 1, [&](int begin, int end) {
+            for (int c = begin; c < end; ++c) {
+                ObjChunk& chunk = chunks[c];
+                // Relative indices may point into earlier chunks, shift them by the vertices before this one
+                for (int corner : chunk.relativeCorners) {
+                    chunk.faces[corner / 3][corner % 3] += vertexOffset[c];
+                }
+                std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + vertexOffset[c]);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffset[c]);
+                std::copy(chunk.faces.begin(), chunk.faces.end(), faces.begin() + faceOffset[c]);
+                std::vector<glm::vec3>().swap(chunk.vertices);
+                std::vector<glm::vec3>().swap(chunk.normals);
+                std::vector<glm::ivec3>().swap(chunk.faces);
             }
-        }
+        });
     }
+    int diff=vertices.size()-normals.size();
+    for (int i =0;i<diff;i++)
+    { 
+        normals.push_back(glm::vec3(0.0));
+    }
+}
+
 
-    return vertexFacesMap;
+// Function to create a map of vertices to the indices of faces containing each vertex
+VertexFaceMap Parser::createVertexFacesMap(const std::vector<glm::ivec3>& faces, int nVertices) {
+    return Mesh::buildVertexFaceMap(faces, nVertices);
 }
 
-glm::vec3 Parser::getVertexNormal(int vidx,const std::vector<glm::ivec3>& faces,const std::vector<int>& faceMap, const std::vector<glm::vec3>& vertices)
+glm::vec3 Parser::getVertexNormal(int vidx,const std::vector<glm::ivec3>& faces,const VertexFaceMap& faceMap, const std::vector<glm::vec3>& vertices)
 {
     glm::vec3 normal=glm::vec3(0);
-    for (int faceidx : faceMap)
+    for (int k=faceMap.offsets[vidx];k<faceMap.offsets[vidx+1];k++)
     {
-        glm::ivec3 face = faces[faceidx];
+        glm::ivec3 face = faces[faceMap.faces[k]];
         int v1idx,v2idx;
         for (int i=0;i<3;i++)
         {
@@ -102,37 +242,40 @@ glm::vec3 Parser::getVertexNormal(int vidx,const std::vector<glm::ivec3>& faces,
 void Parser::setNormals(const std::vector<glm::ivec3>& faces, const std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals)
 {
     // Create a map of vertices to the indices of faces containing each vertex
-    std::map<int, std::vector<int>> vertexFacesMap = createVertexFacesMap(faces);
+    setNormals(faces, vertices, createVertexFacesMap(faces, vertices.size()), normals);
+}
 
+void Parser::setNormals(const std::vector<glm::ivec3>& faces, const std::vector<glm::vec3>& vertices, const VertexFaceMap& faceMap, std::vector<glm::vec3>& normals)
+{
+    // Normals of every vertex from the per-face engine, only the ones missing in the file are used
+    std::vector<glm::vec3> computed(vertices.size());
+    computeVertexNormals(vertices.size(), vertices.data(), faces.size(), &faces.data()->x, faceMap.offsets.data(), faceMap.offsets.data() + 1, faceMap.faces.data(), NormalWeighting::InverseEdgeLength, computed.data());
     for (int i=0;i<vertices.size();i++)
     {
         if(glm::all(glm::equal(normals[i], glm::vec3(0.0f))))
-        normals[i]=getVertexNormal(i,faces,vertexFacesMap[i],vertices);
+        normals[i]=computed[i];
     }
 }
 
 Mesh Parser::objToMesh(const std::string filename)
 {
+    Mesh mesh;
+    if (readMeshCache(filename, mesh))
+    {
+        return mesh;
+    }
+
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec3> normals;
     std::vector<glm::ivec3> faces;
 
     parseOBJ(filename, vertices, normals, faces);
 
-    setNormals(faces,vertices,normals);
+    VertexFaceMap vertexFacesMap = createVertexFacesMap(faces, vertices.size());
 
-    Mesh mesh;
+    setNormals(faces,vertices,vertexFacesMap,normals);
 
-    for (int i =0;i<vertices.size();i++)
-    {
-        mesh.addVertex(vertices[i],normals[i]);
-    }
-    for (auto face:faces)
-    {
-        mesh.addTriangle(face.x,face.y,face.z);
-    }
+    mesh.setMeshData(vertices, normals, faces, vertexFacesMap);
+    writeMeshCache(filename, vertices, normals, faces, vertexFacesMap);
     return mesh;
 }
-
-
-
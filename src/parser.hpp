@@ -14,9 +14,10 @@ class Parser
 {
     public:
         void parseOBJ(const std::string& filename, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::ivec3>& faces);
-        std::map<int, std::vector<int>> createVertexFacesMap(const std::vector<glm::ivec3>& faces);
-        glm::vec3 getVertexNormal(int vidx,const std::vector<glm::ivec3>& faces,const std::vector<int>& faceMap, const std::vector<glm::vec3>& vertices);
+        VertexFaceMap createVertexFacesMap(const std::vector<glm::ivec3>& faces, int nVertices);
+        glm::vec3 getVertexNormal(int vidx,const std::vector<glm::ivec3>& faces,const VertexFaceMap& faceMap, const std::vector<glm::vec3>& vertices);
         void setNormals(const std::vector<glm::ivec3>& faces, const std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals);
+        void setNormals(const std::vector<glm::ivec3>& faces, const std::vector<glm::vec3>& vertices, const VertexFaceMap& faceMap, std::vector<glm::vec3>& normals);
         Mesh objToMesh(const std::string filename);
 };
 
@@ -1,4 +1,5 @@
 #include "parser.hpp"
+#include "validation.hpp"
 
 int main(int argc, char* argv[]) {
 
@@ -12,6 +13,7 @@ int main(int argc, char* argv[]) {
     Parser p;
 
     Mesh mesh=p.objToMesh(filename);    
+    validateMesh(mesh).print(std::cout);
 
     mesh.render();
 
@@ -0,0 +1,84 @@
+#ifndef QUADRIC_HPP
+#define QUADRIC_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Sum of squared distances to a set of planes, error(p) = p^T A p + 2 b.p + c with A symmetric
+struct Quadric
+{
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+
+  Quadric() : a00(0.0), a01(0.0), a02(0.0), a11(0.0), a12(0.0), a22(0.0), b0(0.0), b1(0.0), b2(0.0), c(0.0) {}
+
+  // Add the plane through point with unit normal
+  void addPlane(const glm::vec3 &normal, const glm::vec3 &point, double weight)
+  {
+    addPlane(normal, -((double)normal.x * point.x + (double)normal.y * point.y + (double)normal.z * point.z), weight);
+  }
+
+  // Add the plane normal.p + d = 0, normal of unit length
+  void addPlane(const glm::vec3 &normal, double d, double weight)
+  {
+    double nx = normal.x, ny = normal.y, nz = normal.z;
+    a00 += weight * nx * nx;
+    a01 += weight * nx * ny;
+    a02 += weight * nx * nz;
+    a11 += weight * ny * ny;
+    a12 += weight * ny * nz;
+    a22 += weight * nz * nz;
+    b0 += weight * d * nx;
+    b1 += weight * d * ny;
+    b2 += weight * d * nz;
+    c += weight * d * d;
+  }
+
+  Quadric &operator+=(const Quadric &q)
+  {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a11 += q.a11;
+    a12 += q.a12;
+    a22 += q.a22;
+    b0 += q.b0;
+    b1 += q.b1;
+    b2 += q.b2;
+    c += q.c;
+    return *this;
+  }
+
+  double error(const glm::vec3 &p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    double e = x * (a00 * x + a01 * y + a02 * z) + y * (a01 * x + a11 * y + a12 * z) + z * (a02 * x + a12 * y + a22 * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::max(0.0, e);
+  }
+
+  // Solve A p = -b with the cofactors of A, false if A is close to singular (flat or straight
+  // neighborhoods, where the minimizer is not unique)
+  bool minimizer(glm::vec3 &p) const
+  {
+    double c00 = a11 * a22 - a12 * a12;
+    double c01 = a02 * a12 - a01 * a22;
+    double c02 = a01 * a12 - a02 * a11;
+    double c11 = a00 * a22 - a02 * a02;
+    double c12 = a01 * a02 - a00 * a12;
+    double c22 = a00 * a11 - a01 * a01;
+    double det = a00 * c00 + a01 * c01 + a02 * c02;
+    double trace = a00 + a11 + a22;
+    if (!(std::fabs(det) > 1e-9 * trace * trace * trace))
+    {
+      return false;
+    }
+    p.x = (float)(-(c00 * b0 + c01 * b1 + c02 * b2) / det);
+    p.y = (float)(-(c01 * b0 + c11 * b1 + c12 * b2) / det);
+    p.z = (float)(-(c02 * b0 + c12 * b1 + c22 * b2) / det);
+    return true;
+  }
+};
+
+#endif // QUADRIC_HPP
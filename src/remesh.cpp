@@ -0,0 +1,366 @@
+#include "remesh.hpp"
+#include "halfedge.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <utility>
+
+namespace
+{
+  // Vertices moving less than this fraction of the target length are left out of the next iteration
+  const float minMove = 0.01f;
+
+  // Boundary vertices further than this fraction of the target length from the line through their
+  // two boundary neighbors are corners of the boundary and never collapsed away
+  const float boundaryDeviation = 0.05f;
+
+  double secondsSince(std::chrono::steady_clock::time_point start)
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  class Remesher
+  {
+  public:
+    Remesher(HalfEdgeMesh &mesh, float targetLength)
+        : mesh(mesh), low2(0.8f * 0.8f * targetLength * targetLength), high2(4.0f / 3.0f * 4.0f / 3.0f * targetLength * targetLength), minMove2(minMove * minMove * targetLength * targetLength),
+          deviation2(boundaryDeviation * boundaryDeviation * targetLength * targetLength)
+    {
+      for (int v = 0; v < mesh.numVertices(); ++v)
+      {
+        if (!mesh.isDeletedVertex(v))
+        {
+          touch(v);
+        }
+      }
+    }
+
+    RemeshingStats run(int iterations)
+    {
+      RemeshingStats stats = {};
+      while (stats.iterations < iterations && !touched.empty())
+      {
+        // The vertices touched during the last iteration make up the region of this one
+        region.swap(touched);
+        touched.clear();
+        inRegion.assign(mesh.numVertices(), 0);
+        isTouched.assign(mesh.numVertices(), 0);
+        for (size_t i = 0; i < region.size(); ++i)
+        {
+          inRegion[region[i]] = 1;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        stats.splits += splitLongEdges();
+        stats.splitSeconds += secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        stats.collapses += collapseShortEdges();
+        stats.collapseSeconds += secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        stats.flips += equalizeValences();
+        stats.flipSeconds += secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        stats.relaxedVertices += relaxTangentially();
+        stats.relaxSeconds += secondsSince(start);
+
+        ++stats.iterations;
+      }
+      return stats;
+    }
+
+  private:
+    HalfEdgeMesh &mesh;
+    float low2, high2, minMove2, deviation2;
+
+    // Vertices the current iteration works on, growing with every edit
+    std::vector<int> region;
+    std::vector<char> inRegion;
+    // Vertices edited or moved during the current iteration, the region of the next one
+    std::vector<int> touched;
+    std::vector<char> isTouched;
+
+    // Edges waiting for the current stage, as vertex pairs since half-edges move under edits
+    std::vector<std::pair<int, int> > queue;
+
+    void touch(int v)
+    {
+      if (v >= (int)isTouched.size())
+      {
+        isTouched.resize(mesh.numVertices(), 0);
+        inRegion.resize(mesh.numVertices(), 0);
+      }
+      if (!isTouched[v])
+      {
+        isTouched[v] = 1;
+        touched.push_back(v);
+      }
+      if (!inRegion[v])
+      {
+        inRegion[v] = 1;
+        region.push_back(v);
+      }
+    }
+
+    // Queue every edge around the region once
+    void seedQueue()
+    {
+      queue.clear();
+      for (size_t i = 0; i < region.size(); ++i)
+      {
+        int v = region[i];
+        if (mesh.isDeletedVertex(v))
+        {
+          continue;
+        }
+        mesh.forEachNeighbor(v, [&](int u)
+        {
+          if (!inRegion[u] || v < u)
+          {
+            queue.push_back(std::make_pair(v, u));
+          }
+        });
+      }
+    }
+
+    // Touch v and its neighbors and queue the edges around v
+    void touchAround(int v)
+    {
+      touch(v);
+      mesh.forEachNeighbor(v, [&](int u)
+      {
+        touch(u);
+        queue.push_back(std::make_pair(v, u));
+      });
+    }
+
+    // Half-edge between two live vertices in either direction, -1 if the edge is gone
+    int findEdge(int a, int b) const
+    {
+      if (mesh.isDeletedVertex(a) || mesh.isDeletedVertex(b))
+      {
+        return -1;
+      }
+      int h = mesh.findHalfEdge(a, b);
+      return h >= 0 ? h : mesh.findHalfEdge(b, a);
+    }
+
+    float length2(int h) const
+    {
+      glm::vec3 e = mesh.position(mesh.target(h)) - mesh.position(mesh.source(h));
+      return glm::dot(e, e);
+    }
+
+    // Whether the triangle normals n0 and n1 are more than 60 degrees apart, or n1 is zero. Checking
+    // only for opposite normals lets edits stand triangles on edge, e.g. over three boundary vertices.
+    static bool turnsAway(const glm::vec3 &n0, const glm::vec3 &n1)
+    {
+      return glm::dot(n0, n1) <= 0.5f * glm::length(n0) * glm::length(n1);
+    }
+
+    // Whether the boundary runs straight enough through b, reached along the boundary half-edge
+    // from a, that dropping b leaves its shape alone
+    bool isStraightBoundary(int a, int b) const
+    {
+      int c = mesh.target(mesh.outgoing(b));
+      glm::vec3 chord = mesh.position(c) - mesh.position(a);
+      glm::vec3 offset = glm::cross(chord, mesh.position(b) - mesh.position(a));
+      return c != a && glm::dot(offset, offset) <= deviation2 * glm::dot(chord, chord);
+    }
+
+    // Whether moving a and b to pos turns away one of the faces around v (a or b) that survive the collapse of a and b
+    bool foldsOver(int v, int a, int b, const glm::vec3 &pos) const
+    {
+      int h0 = mesh.outgoing(v), h = h0;
+      do
+      {
+        int corners[3] = {v, mesh.target(h), mesh.source(mesh.prev(h))};
+        if (corners[1] != a && corners[1] != b && corners[2] != a && corners[2] != b)
+        {
+          glm::vec3 before[3], after[3];
+          for (int i = 0; i < 3; ++i)
+          {
+            before[i] = mesh.position(corners[i]);
+            after[i] = corners[i] == a || corners[i] == b ? pos : before[i];
+          }
+          glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+          glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+          if (turnsAway(n0, n1))
+          {
+            return true;
+          }
+        }
+        h = mesh.nextOutgoing(h);
+      } while (h >= 0 && h != h0);
+      return false;
+    }
+
+    int splitLongEdges()
+    {
+      int splits = 0;
+      seedQueue();
+      for (size_t i = 0; i < queue.size(); ++i)
+      {
+        int h = findEdge(queue[i].first, queue[i].second);
+        if (h < 0 || length2(h) <= high2)
+        {
+          continue;
+        }
+        touchAround(mesh.split(h));
+        ++splits;
+      }
+      return splits;
+    }
+
+    int collapseShortEdges()
+    {
+      int collapses = 0;
+      seedQueue();
+      for (size_t i = 0; i < queue.size(); ++i)
+      {
+        int h = findEdge(queue[i].first, queue[i].second);
+        if (h < 0 || length2(h) >= low2)
+        {
+          continue;
+        }
+        // Boundary vertices never move. One absorbs its interior neighbor, and of two boundary
+        // vertices the source keeps its place and absorbs the target, only along the boundary
+        // and only where the boundary runs straight through the target.
+        bool sourceOnBoundary = mesh.isBoundaryVertex(mesh.source(h)), targetOnBoundary = mesh.isBoundaryVertex(mesh.target(h));
+        if (sourceOnBoundary && targetOnBoundary)
+        {
+          if (mesh.twin(h) >= 0 || !isStraightBoundary(mesh.source(h), mesh.target(h)))
+          {
+            continue;
+          }
+        }
+        else if (targetOnBoundary)
+        {
+          h = mesh.twin(h);
+        }
+        int a = mesh.source(h), b = mesh.target(h);
+        glm::vec3 pos = sourceOnBoundary || targetOnBoundary ? mesh.position(a) : (mesh.position(a) + mesh.position(b)) / 2.0f;
+
+        // No edge of the merged vertex may come out long enough to be split again
+        bool tooLong = false;
+        int ends[2] = {a, b};
+        for (int k = 0; k < 2 && !tooLong; ++k)
+        {
+          mesh.forEachNeighbor(ends[k], [&](int u)
+          {
+            glm::vec3 e = mesh.position(u) - pos;
+            tooLong = tooLong || (u != a && u != b && glm::dot(e, e) > high2);
+          });
+        }
+        if (tooLong || foldsOver(a, a, b, pos) || foldsOver(b, a, b, pos) || !mesh.collapse(h, pos))
+        {
+          continue;
+        }
+        touchAround(a);
+        ++collapses;
+      }
+      return collapses;
+    }
+
+    // Valence of v minus its ideal, 6 inside and 4 on the boundary
+    int excess(int v) const
+    {
+      return mesh.valence(v) - (mesh.isBoundaryVertex(v) ? 4 : 6);
+    }
+
+    int equalizeValences()
+    {
+      int flips = 0;
+      seedQueue();
+      for (size_t i = 0; i < queue.size(); ++i)
+      {
+        int h = findEdge(queue[i].first, queue[i].second);
+        if (h < 0 || mesh.twin(h) < 0)
+        {
+          continue;
+        }
+        int a = mesh.source(h), b = mesh.target(h);
+        int c = mesh.source(mesh.prev(h)), d = mesh.source(mesh.prev(mesh.twin(h)));
+        int ea = excess(a), eb = excess(b), ec = excess(c), ed = excess(d);
+        int before = std::abs(ea) + std::abs(eb) + std::abs(ec) + std::abs(ed);
+        int after = std::abs(ea - 1) + std::abs(eb - 1) + std::abs(ec + 1) + std::abs(ed + 1);
+        // Strict improvement, so the stage terminates. The new triangles (a, d, c) and (b, c, d) must not
+        // fold onto each other. A new edge ending on the boundary can stand a triangle on its edge along
+        // the boundary, so there they must not even turn away from each other.
+        const glm::vec3 &pa = mesh.position(a), &pb = mesh.position(b), &pc = mesh.position(c), &pd = mesh.position(d);
+        glm::vec3 nc = glm::cross(pd - pa, pc - pa), nd = glm::cross(pc - pb, pd - pb);
+        bool nearBoundary = mesh.isBoundaryVertex(c) || mesh.isBoundaryVertex(d);
+        if (after >= before || (nearBoundary ? turnsAway(nc, nd) : glm::dot(nc, nd) <= 0.0f) || !mesh.flip(h))
+        {
+          continue;
+        }
+        touchAround(a);
+        touchAround(b);
+        touchAround(c);
+        touchAround(d);
+        ++flips;
+      }
+      return flips;
+    }
+
+    // Move the interior vertices of the region towards the centroid of their neighbors, within the
+    // plane of their area-weighted normal. All moves are computed before any is applied.
+    int relaxTangentially()
+    {
+      std::vector<int> vertices;
+      std::vector<glm::vec3> moved;
+      for (size_t i = 0; i < region.size(); ++i)
+      {
+        int v = region[i];
+        if (mesh.isDeletedVertex(v) || mesh.outgoing(v) < 0 || mesh.isBoundaryVertex(v))
+        {
+          continue;
+        }
+        const glm::vec3 &p = mesh.position(v);
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        int n = 0;
+        int h0 = mesh.outgoing(v), h = h0;
+        do
+        {
+          const glm::vec3 &q = mesh.position(mesh.target(h));
+          centroid += q;
+          ++n;
+          normal += glm::cross(q - p, mesh.position(mesh.source(mesh.prev(h))) - p);
+          h = mesh.nextOutgoing(h);
+        } while (h >= 0 && h != h0);
+        float l = glm::length(normal);
+        glm::vec3 d = centroid / (float)n - p;
+        if (l > 0.0f)
+        {
+          normal /= l;
+          d -= normal * glm::dot(normal, d);
+        }
+        vertices.push_back(v);
+        moved.push_back(p + d);
+      }
+
+      for (size_t i = 0; i < vertices.size(); ++i)
+      {
+        glm::vec3 d = moved[i] - mesh.position(vertices[i]);
+        mesh.setPosition(vertices[i], moved[i]);
+        if (glm::dot(d, d) > minMove2)
+        {
+          touch(vertices[i]);
+        }
+      }
+      return vertices.size();
+    }
+  };
+}
+
+RemeshingStats remeshIsotropic(Mesh &mesh, float targetLength, int iterations)
+{
+  HalfEdgeMesh halfEdges(mesh);
+  Remesher remesher(halfEdges, targetLength);
+  RemeshingStats stats = remesher.run(iterations);
+  halfEdges.toMesh(mesh);
+  mesh.computeNormals();
+  return stats;
+}
@@ -0,0 +1,39 @@
+#ifndef REMESH_HPP
+#define REMESH_HPP
+
+#include "mesh.hpp"
+
+// Work done by a remeshing run, per stage
+struct RemeshingStats
+{
+  int iterations;
+  int splits;
+  int collapses;
+  int flips;
+  int relaxedVertices;
+  double splitSeconds;
+  double collapseSeconds;
+  double flipSeconds;
+  double relaxSeconds;
+};
+
+// Isotropic remeshing (Botsch and Kobbelt) towards edges of length targetLength, on a half-edge
+// copy of the mesh. Every iteration
+//  - splits edges longer than 4/3 targetLength at their midpoint,
+//  - collapses edges shorter than 4/5 targetLength unless that makes an edge longer than
+//    4/3 targetLength, turns a triangle by more than 60 degrees or breaks the link condition.
+//    Boundary vertices stay in place: a boundary vertex absorbs its interior neighbor, and a
+//    boundary edge collapses into one of its ends only where the boundary runs straight
+//    through the other, so open boundaries keep their shape and corners,
+//  - flips edges that bring the valences of the four vertices involved closer to 6 (4 on the
+//    boundary), unless the two new triangles fold onto each other (or are more than 60 degrees
+//    apart, next to the boundary),
+//  - moves interior vertices towards the centroid of their neighbors within their tangent plane.
+// No stage scans the whole mesh: each works through a queue seeded with the edges or vertices
+// around the vertices touched since the previous iteration (all of them at first), and every
+// edit queues its own neighborhood. Stops after the given number of iterations or once an
+// iteration changes nothing. Vertices are not projected back onto the input surface.
+// The mesh is replaced by the result, with new normals.
+RemeshingStats remeshIsotropic(Mesh &mesh, float targetLength, int iterations = 10);
+
+#endif // REMESH_HPP
@@ -0,0 +1,457 @@
+#include "validation.hpp"
+#include "edge_index.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <stdint.h>
+
+namespace
+{
+  // Vertices or triangles per block; blocks are merged in order so the samples are the first ones
+  const int blockSize = 16384;
+
+  // Violations found in one block
+  template <typename Sample>
+  struct Recorder
+  {
+    ValidationIssue<Sample> *issue;
+    int maxSamples;
+
+    void operator()(const Sample &sample) const
+    {
+      ++issue->count;
+      if ((int)issue->samples.size() < maxSamples)
+      {
+        issue->samples.push_back(sample);
+      }
+    }
+  };
+
+  template <typename Sample>
+  void merge(const std::vector<ValidationIssue<Sample> > &blocks, int maxSamples, ValidationIssue<Sample> &issue)
+  {
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+      issue.count += blocks[b].count;
+      for (size_t i = 0; i < blocks[b].samples.size() && (int)issue.samples.size() < maxSamples; ++i)
+      {
+        issue.samples.push_back(blocks[b].samples[i]);
+      }
+    }
+  }
+
+  // Call scan(i, record) for every i in [0, n) in parallel blocks, where scan calls record(sample)
+  // for each violation at element i
+  template <typename Sample, typename Scan>
+  void collect(int n, int maxSamples, ValidationIssue<Sample> &issue, Scan scan)
+  {
+    int nBlocks = (n + blockSize - 1) / blockSize;
+    std::vector<ValidationIssue<Sample> > blocks(nBlocks);
+    parallelFor(nBlocks, 1, [&](int first, int last)
+    {
+      for (int b = first; b < last; ++b)
+      {
+        Recorder<Sample> record = {&blocks[b], maxSamples};
+        for (int i = b * blockSize; i < std::min(n, (b + 1) * blockSize); ++i)
+        {
+          scan(i, record);
+        }
+      }
+    });
+    merge(blocks, maxSamples, issue);
+  }
+
+  bool inRange(const Triangle &triangle, int nVertices)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      if (triangle.vertices[i] < 0 || triangle.vertices[i] >= nVertices)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Corner of v in the triangle, -1 if v is not a corner
+  int cornerOf(const Triangle &triangle, int v)
+  {
+    for (int i = 0; i < 3; ++i)
+    {
+      if (triangle.vertices[i] == v)
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  bool isDegenerate(const Triangle &triangle, const glm::vec3 *positions)
+  {
+    const glm::vec3 &p0 = positions[triangle.vertices[0]];
+    glm::vec3 normal = glm::cross(positions[triangle.vertices[1]] - p0, positions[triangle.vertices[2]] - p0);
+    return glm::all(glm::equal(normal, glm::vec3(0.0f)));
+  }
+
+  // Whether the triangle faces away from the normal of one of its corners
+  bool isFlipped(const Triangle &triangle, const glm::vec3 *positions, const glm::vec3 *normals)
+  {
+    const glm::vec3 &p0 = positions[triangle.vertices[0]];
+    glm::vec3 normal = glm::cross(positions[triangle.vertices[1]] - p0, positions[triangle.vertices[2]] - p0);
+    for (int i = 0; i < 3; ++i)
+    {
+      if (glm::dot(normal, normals[triangle.vertices[i]]) < 0)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Whether every corner of triangle t lists it
+  bool isListedAtCorners(const Mesh &mesh, int t)
+  {
+    for (int v : mesh.triangleData()[t].vertices)
+    {
+      IndexRange around = mesh.adjacentTriangles(v);
+      if (std::find(around.begin(), around.end(), t) == around.end())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // An edge seen from one of its endpoints, in or out of it in one triangle
+  struct EdgeEnd
+  {
+    int other;
+    bool outgoing;
+
+    bool operator<(const EdgeEnd &e) const { return other < e.other; }
+  };
+
+  // The edges around every vertex from its adjacency list: each triangle at v adds the edge to
+  // the corner after v (leaving v) and the one before it (entering v)
+  void checkEdges(const Mesh &mesh, int maxSamples, ValidationReport &report)
+  {
+    int nVertices = mesh.numVertices(), nTriangles = mesh.numTriangles();
+    const Triangle *triangles = mesh.triangleData();
+    int nBlocks = (nVertices + blockSize - 1) / blockSize;
+    std::vector<ValidationIssue<glm::ivec2> > nonManifold(nBlocks), inconsistent(nBlocks), boundary(nBlocks);
+    std::vector<ValidationIssue<int> > pinched(nBlocks);
+    parallelFor(nBlocks, 1, [&](int first, int last)
+    {
+      std::vector<EdgeEnd> ends;
+      for (int b = first; b < last; ++b)
+      {
+        Recorder<glm::ivec2> recordNonManifold = {&nonManifold[b], maxSamples};
+        Recorder<glm::ivec2> recordInconsistent = {&inconsistent[b], maxSamples};
+        Recorder<glm::ivec2> recordBoundary = {&boundary[b], maxSamples};
+        Recorder<int> recordPinched = {&pinched[b], maxSamples};
+        for (int v = b * blockSize; v < std::min(nVertices, (b + 1) * blockSize); ++v)
+        {
+          if (mesh.isDeletedVertex(v))
+          {
+            continue;
+          }
+          ends.clear();
+          for (int t : mesh.adjacentTriangles(v))
+          {
+            if (t < 0 || t >= nTriangles || mesh.isDeletedTriangle(t) || !inRange(triangles[t], nVertices))
+            {
+              continue;
+            }
+            int c = cornerOf(triangles[t], v);
+            if (c >= 0)
+            {
+              EdgeEnd out = {triangles[t].vertices[(c + 1) % 3], true};
+              EdgeEnd in = {triangles[t].vertices[(c + 2) % 3], false};
+              ends.push_back(out);
+              ends.push_back(in);
+            }
+          }
+          std::sort(ends.begin(), ends.end());
+
+          // Each triangle on the edge (v, u) adds one entry for u, so a group is the number of triangles on it
+          int boundaryEdges = 0;
+          for (size_t i = 0; i < ends.size();)
+          {
+            size_t j = i;
+            int outgoing = 0;
+            for (; j < ends.size() && ends[j].other == ends[i].other; ++j)
+            {
+              outgoing += ends[j].outgoing;
+            }
+            int u = ends[i].other, shared = j - i;
+            boundaryEdges += shared == 1;
+            // Every edge is reported from its lower endpoint
+            if (v < u)
+            {
+              glm::ivec2 edge(v, u);
+              if (shared > 2)
+                recordNonManifold(edge);
+              else if (outgoing > 1 || shared - outgoing > 1)
+                recordInconsistent(edge);
+              else if (shared == 1)
+                recordBoundary(edge);
+            }
+            i = j;
+          }
+          if (boundaryEdges > 2)
+          {
+            recordPinched(v);
+          }
+        }
+      }
+    });
+    merge(nonManifold, maxSamples, report.nonManifoldEdges);
+    merge(inconsistent, maxSamples, report.inconsistentEdges);
+    merge(boundary, maxSamples, report.boundaryEdges);
+    merge(pinched, maxSamples, report.nonManifoldVertices);
+  }
+
+  void printSample(std::ostream &out, int sample) { out << " " << sample; }
+  void printSample(std::ostream &out, const glm::ivec2 &sample) { out << " (" << sample.x << ", " << sample.y << ")"; }
+
+  template <typename Sample>
+  void printIssue(std::ostream &out, const char *name, const ValidationIssue<Sample> &issue)
+  {
+    if (issue.count == 0)
+    {
+      return;
+    }
+    out << name << ": " << issue.count << ", e.g.";
+    for (size_t i = 0; i < issue.samples.size(); ++i)
+    {
+      printSample(out, issue.samples[i]);
+    }
+    out << std::endl;
+  }
+}
+
+bool ValidationReport::isValid() const
+{
+  return triangleIndexOutOfRange.count == 0 && adjacencyOutOfRange.count == 0 && strayAdjacency.count == 0 && missingAdjacency.count == 0 && degenerateTriangles.count == 0 && duplicateTriangles.count == 0 && flippedTriangles.count == 0 && nonManifoldEdges.count == 0 && inconsistentEdges.count == 0 && nonManifoldVertices.count == 0;
+}
+
+void ValidationReport::print(std::ostream &out) const
+{
+  if (isValid())
+  {
+    out << "Mesh is valid, " << boundaryEdges.count << " boundary edges" << std::endl;
+  }
+  printIssue(out, "Triangle index out of bound", triangleIndexOutOfRange);
+  printIssue(out, "Adjacent triangle index out of bound", adjacencyOutOfRange);
+  printIssue(out, "Vertex lists a triangle it is not part of", strayAdjacency);
+  printIssue(out, "Triangle missing from the list of a corner", missingAdjacency);
+  printIssue(out, "Degenerate triangle", degenerateTriangles);
+  printIssue(out, "Duplicate triangle", duplicateTriangles);
+  printIssue(out, "Triangle facing away from a corner normal", flippedTriangles);
+  printIssue(out, "Edge shared by more than two triangles", nonManifoldEdges);
+  printIssue(out, "Edge with inconsistent orientation", inconsistentEdges);
+  printIssue(out, "Vertex joining several boundaries", nonManifoldVertices);
+  if (!isValid())
+  {
+    printIssue(out, "Boundary edge", boundaryEdges);
+  }
+}
+
+ValidationReport validateMesh(const Mesh &mesh, int maxSamples)
+{
+  ValidationReport report;
+  int nVertices = mesh.numVertices(), nTriangles = mesh.numTriangles();
+  const Triangle *triangles = mesh.triangleData();
+  const glm::vec3 *positions = mesh.positionData();
+  const glm::vec3 *normals = mesh.normalData();
+
+  collect(nTriangles, maxSamples, report.triangleIndexOutOfRange, [&](int t, const Recorder<int> &record)
+  {
+    if (!mesh.isDeletedTriangle(t) && !inRange(triangles[t], nVertices))
+      record(t);
+  });
+
+  collect(nVertices, maxSamples, report.adjacencyOutOfRange, [&](int v, const Recorder<int> &record)
+  {
+    for (int t : mesh.adjacentTriangles(v))
+    {
+      if (t < 0 || t >= nTriangles)
+      {
+        record(v);
+        return;
+      }
+    }
+  });
+
+  // Both directions of the vertex-triangle incidence
+  collect(nVertices, maxSamples, report.strayAdjacency, [&](int v, const Recorder<int> &record)
+  {
+    if (mesh.isDeletedVertex(v))
+    {
+      return;
+    }
+    for (int t : mesh.adjacentTriangles(v))
+    {
+      if (t >= 0 && t < nTriangles && !mesh.isDeletedTriangle(t) && cornerOf(triangles[t], v) < 0)
+      {
+        record(v);
+        return;
+      }
+    }
+  });
+  collect(nTriangles, maxSamples, report.missingAdjacency, [&](int t, const Recorder<int> &record)
+  {
+    if (!mesh.isDeletedTriangle(t) && inRange(triangles[t], nVertices) && !isListedAtCorners(mesh, t))
+      record(t);
+  });
+
+  // Geometry, one visit per triangle
+  collect(nTriangles, maxSamples, report.degenerateTriangles, [&](int t, const Recorder<int> &record)
+  {
+    if (!mesh.isDeletedTriangle(t) && inRange(triangles[t], nVertices) && isDegenerate(triangles[t], positions))
+      record(t);
+  });
+  collect(nTriangles, maxSamples, report.flippedTriangles, [&](int t, const Recorder<int> &record)
+  {
+    if (!mesh.isDeletedTriangle(t) && inRange(triangles[t], nVertices) && isFlipped(triangles[t], positions, normals))
+      record(t);
+  });
+
+  std::vector<int> duplicates;
+  findDuplicateTriangles(nTriangles, triangles, false, duplicates);
+  report.duplicateTriangles.count = duplicates.size();
+  duplicates.resize(std::min((int)duplicates.size(), maxSamples));
+  report.duplicateTriangles.samples = duplicates;
+
+  checkEdges(mesh, maxSamples, report);
+  return report;
+}
+
+void validateLocal(const Mesh &mesh, const int *vertices, int nVertices, int maxSamples, ValidationReport &report)
+{
+  int nMeshVertices = mesh.numVertices(), nTriangles = mesh.numTriangles();
+  const Triangle *triangles = mesh.triangleData();
+  Recorder<int> recordTriangleIndex = {&report.triangleIndexOutOfRange, maxSamples};
+  Recorder<int> recordAdjacencyIndex = {&report.adjacencyOutOfRange, maxSamples};
+  Recorder<int> recordStray = {&report.strayAdjacency, maxSamples};
+  Recorder<int> recordMissing = {&report.missingAdjacency, maxSamples};
+  Recorder<int> recordDegenerate = {&report.degenerateTriangles, maxSamples};
+  Recorder<int> recordFlipped = {&report.flippedTriangles, maxSamples};
+
+  // Triangles around the vertices, each checked once even if several of them list it
+  std::vector<int> around;
+  for (int i = 0; i < nVertices; ++i)
+  {
+    int v = vertices[i];
+    if (v < 0 || v >= nMeshVertices)
+    {
+      continue;
+    }
+    bool outOfRange = false, stray = false;
+    for (int t : mesh.adjacentTriangles(v))
+    {
+      if (t < 0 || t >= nTriangles)
+      {
+        outOfRange = true;
+        continue;
+      }
+      // A deleted vertex lists nothing, a deleted triangle is listed nowhere
+      stray = stray || mesh.isDeletedVertex(v) || mesh.isDeletedTriangle(t) || cornerOf(triangles[t], v) < 0;
+      around.push_back(t);
+    }
+    if (outOfRange)
+      recordAdjacencyIndex(v);
+    if (stray)
+      recordStray(v);
+  }
+  std::sort(around.begin(), around.end());
+  around.erase(std::unique(around.begin(), around.end()), around.end());
+
+  for (size_t i = 0; i < around.size(); ++i)
+  {
+    int t = around[i];
+    if (mesh.isDeletedTriangle(t))
+    {
+      continue;
+    }
+    if (!inRange(triangles[t], nMeshVertices))
+    {
+      recordTriangleIndex(t);
+      continue;
+    }
+    if (!isListedAtCorners(mesh, t))
+      recordMissing(t);
+    if (isDegenerate(triangles[t], mesh.positionData()))
+      recordDegenerate(t);
+    if (isFlipped(triangles[t], mesh.positionData(), mesh.normalData()))
+      recordFlipped(t);
+  }
+}
+
+void findDuplicateTriangles(int nTriangles, const Triangle *triangles, bool firstOnly, std::vector<int> &duplicates)
+{
+  duplicates.clear();
+
+  // Sorted corners and their hash, in parallel. Tombstones have three equal corners.
+  std::vector<glm::ivec3> sorted(nTriangles);
+  std::vector<uint64_t> hashes(nTriangles);
+  parallelFor(nTriangles, blockSize, [&](int begin, int end)
+  {
+    for (int t = begin; t < end; ++t)
+    {
+      int *v = &sorted[t].x;
+      std::copy(triangles[t].vertices, triangles[t].vertices + 3, v);
+      std::sort(v, v + 3);
+      // 32 bits are enough to keep runs short and halve the radix sort passes
+      hashes[t] = (uint32_t)hashKey(hashKey((uint32_t)v[0]) ^ ((uint64_t)(uint32_t)v[1] << 32 | (uint32_t)v[2]));
+    }
+  });
+
+  // Triangle indices in hash order, equal hashes in index order
+  std::vector<int> order(nTriangles);
+  for (int t = 0; t < nTriangles; ++t)
+  {
+    order[t] = t;
+  }
+  radixSortByKey(hashes, order);
+
+  // Equal corners now sit in runs of equal hashes, each searched by the block it starts in
+  int nBlocks = (nTriangles + blockSize - 1) / blockSize;
+  std::vector<std::vector<int> > found(nBlocks);
+  parallelFor(nBlocks, 1, [&](int firstBlock, int lastBlock)
+  {
+    for (int b = firstBlock; b < lastBlock; ++b)
+    {
+      for (int first = b * blockSize; first < std::min(nTriangles, (b + 1) * blockSize); ++first)
+      {
+        if (first > 0 && hashes[first] == hashes[first - 1])
+        {
+          continue;
+        }
+        for (int i = first + 1; i < nTriangles && hashes[i] == hashes[first]; ++i)
+        {
+          const glm::ivec3 &corners = sorted[order[i]];
+          bool duplicate = false;
+          for (int j = first; j < i && !duplicate && corners.x != corners.z; ++j)
+          {
+            duplicate = sorted[order[j]] == corners;
+          }
+          if (duplicate)
+          {
+            found[b].push_back(order[i]);
+          }
+        }
+      }
+    }
+  });
+
+  for (int b = 0; b < nBlocks; ++b)
+  {
+    duplicates.insert(duplicates.end(), found[b].begin(), found[b].end());
+  }
+  std::sort(duplicates.begin(), duplicates.end());
+  if (firstOnly && !duplicates.empty())
+  {
+    duplicates.resize(1);
+  }
+}
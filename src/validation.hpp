@@ -0,0 +1,59 @@
+#ifndef VALIDATION_HPP
+#define VALIDATION_HPP
+
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+
+// Elements failing one check: how many there are and the first few of them in index order
+template <typename Sample>
+struct ValidationIssue
+{
+  int count;
+  std::vector<Sample> samples;
+
+  ValidationIssue() : count(0) {}
+};
+
+// Everything validateMesh found, vertices and triangles by index and edges as (lower, higher)
+// vertex pairs. Deleted vertices and triangles are not checked.
+struct ValidationReport
+{
+  ValidationIssue<int> triangleIndexOutOfRange; // triangles with a corner that is not a vertex
+  ValidationIssue<int> adjacencyOutOfRange;     // vertices listing a triangle that does not exist
+  ValidationIssue<int> strayAdjacency;          // vertices listing a triangle that does not use them
+  ValidationIssue<int> missingAdjacency;        // triangles missing from the list of one of their corners
+  ValidationIssue<int> degenerateTriangles;     // triangles with zero area
+  ValidationIssue<int> duplicateTriangles;      // triangles repeating the corners of an earlier one
+  ValidationIssue<int> flippedTriangles;        // triangles facing away from the normal of a corner
+  ValidationIssue<glm::ivec2> nonManifoldEdges; // edges shared by more than two triangles
+  ValidationIssue<glm::ivec2> inconsistentEdges; // edges both triangles run through in the same direction
+  ValidationIssue<glm::ivec2> boundaryEdges;    // edges of a single triangle, allowed
+  ValidationIssue<int> nonManifoldVertices;     // vertices where more than two boundary edges meet
+
+  // Whether no check other than boundaryEdges failed
+  bool isValid() const;
+
+  // One line per failed check, or a single line if there are none
+  void print(std::ostream &out) const;
+};
+
+// Run every check over the whole mesh and collect all violations, keeping up to maxSamples
+// of each kind. Each check is a parallel pass and the report does not depend on the number
+// of threads. Edge checks use the adjacency lists, so they are only meaningful when the
+// adjacency checks pass.
+ValidationReport validateMesh(const Mesh &mesh, int maxSamples = 8);
+
+// Check only the given vertices and the triangles around them, after a local edit: index
+// bounds, vertex-triangle incidence in both directions, degenerate and flipped triangles.
+// Costs O(size of their one-rings) and adds what it finds to report.
+void validateLocal(const Mesh &mesh, const int *vertices, int nVertices, int maxSamples, ValidationReport &report);
+
+// Indices of the triangles repeating the corners of an earlier one in any order, in increasing
+// order. Parallel in O(T): the triangles are radix sorted by a hash of their sorted corners and
+// compared within runs of equal hashes. Triangles with three equal corners (edgeCollapse
+// tombstones) are skipped, and only the lowest duplicate is kept if firstOnly is set.
+void findDuplicateTriangles(int nTriangles, const Triangle *triangles, bool firstOnly, std::vector<int> &duplicates);
+
+#endif // VALIDATION_HPP
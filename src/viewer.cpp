@@ -63,6 +63,10 @@ namespace COL781 {
             object = r.createObject();
             r.enableDepthTest();
             camera.initialize((float)width/(float)height);
+            projection = camera.getProjectionMatrix();
+            deltaAngleX = 2.0 * 3.14 / 800.0;
+            deltaAngleY = 3.14 / 600.0;
+            SDL_GetMouseState(&lastxPos, &lastyPos);
             return true;
         }
 
@@ -74,98 +78,138 @@ namespace COL781 {
             r.setVertexAttribs(object, 1, n, normals);
         }
 
+        void Viewer::setVertexData(int n, const glm::vec3* vertices, const glm::vec3* normals) {
+            r.setInterleavedVertices(object, n, vertices, normals);
+        }
+
         void Viewer::setTriangles(int n, const glm::ivec3* triangles) {
             r.setTriangleIndices(object, n, triangles);
         }
 
+        void Viewer::publish(int nVertices, const glm::vec3* vertices, const glm::vec3* normals) {
+            std::lock_guard<std::mutex> lock(stagingMutex);
+            stagedVertices.assign(vertices, vertices + nVertices);
+            stagedNormals.assign(normals, normals + nVertices);
+            verticesStaged = true;
+        }
+
+        void Viewer::publish(int nVertices, const glm::vec3* vertices, const glm::vec3* normals, int nTriangles, const glm::ivec3* triangles) {
+            std::lock_guard<std::mutex> lock(stagingMutex);
+            stagedVertices.assign(vertices, vertices + nVertices);
+            stagedNormals.assign(normals, normals + nVertices);
+            stagedTriangles.assign(triangles, triangles + nTriangles);
+            verticesStaged = true;
+            trianglesStaged = true;
+        }
+
         void Viewer::view() {
-            // The transformation matrix.
-            glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 view;    
-            glm::mat4 projection = camera.getProjectionMatrix();
+            while (frame()) {
+            }
+        }
 
-            float deltaAngleX = 2.0 * 3.14 / 800.0;
-            float deltaAngleY = 3.14 / 600.0;
+        bool Viewer::frame() {
+            if (r.shouldQuit())
+                return false;
 
-            int lastxPos, lastyPos, xPos, yPos;
+            // Take the staged data under the lock, upload it outside
+            bool newVertices, newTriangles;
+            {
+                std::lock_guard<std::mutex> lock(stagingMutex);
+                newVertices = verticesStaged;
+                newTriangles = trianglesStaged;
+                if (newVertices) {
+                    uploadVertices.swap(stagedVertices);
+                    uploadNormals.swap(stagedNormals);
+                }
+                if (newTriangles)
+                    uploadTriangles.swap(stagedTriangles);
+                verticesStaged = trianglesStaged = false;
+            }
+            if (newVertices)
+                r.setInterleavedVertices(object, uploadVertices.size(), uploadVertices.data(), uploadNormals.data());
+            if (newTriangles)
+                r.setTriangleIndices(object, uploadTriangles.size(), uploadTriangles.data());
 
-            SDL_GetMouseState(&lastxPos, &lastyPos);
+            // The transformation matrix.
+            glm::mat4 model = glm::mat4(1.0f);
+            glm::mat4 view;
 
-            while (!r.shouldQuit()) {
-                r.clear(glm::vec4(1.0, 1.0, 1.0, 1.0));
+            int xPos, yPos;
 
-                camera.updateViewMatrix();
+            r.clear(glm::vec4(1.0, 1.0, 1.0, 1.0));
 
-                Uint32 buttonState = SDL_GetMouseState(&xPos, &yPos);
-                if( buttonState & SDL_BUTTON(SDL_BUTTON_LEFT) ) {
-                    glm::vec4 pivot = glm::vec4(camera.lookAt.x, camera.lookAt.y, camera.lookAt.z, 1.0f);
-                    glm::vec4 position = glm::vec4(camera.position.x, camera.position.y, camera.position.z, 1.0f);
+            camera.updateViewMatrix();
 
-                    float xAngle = (float)(lastxPos - xPos) * deltaAngleX;
-                    float yAngle = (float)(lastyPos - yPos) * deltaAngleY;
+            Uint32 buttonState = SDL_GetMouseState(&xPos, &yPos);
+            if( buttonState & SDL_BUTTON(SDL_BUTTON_LEFT) ) {
+                glm::vec4 pivot = glm::vec4(camera.lookAt.x, camera.lookAt.y, camera.lookAt.z, 1.0f);
+                glm::vec4 position = glm::vec4(camera.position.x, camera.position.y, camera.position.z, 1.0f);
 
-                    float cosAngle = dot(camera.getViewDir(), camera.up);
+                float xAngle = (float)(lastxPos - xPos) * deltaAngleX;
+                float yAngle = (float)(lastyPos - yPos) * deltaAngleY;
 
-                    if(cosAngle * signbit(deltaAngleY) > 0.99f)
-                        deltaAngleY = 0.0f;
+                float cosAngle = dot(camera.getViewDir(), camera.up);
 
-                    glm::mat4 rotationMatX(1.0f);
-                    rotationMatX = glm::rotate(rotationMatX, xAngle, camera.up);
-                    position = (rotationMatX * (position - pivot)) + pivot;
+                if(cosAngle * signbit(deltaAngleY) > 0.99f)
+                    deltaAngleY = 0.0f;
 
-                    glm::mat4 rotationMatY(1.0f);
-                    rotationMatY = glm::rotate(rotationMatY, yAngle, camera.getRightVector());
-                    glm::vec3 finalPosition = (rotationMatY * (position - pivot)) + pivot;
-                    camera.position = finalPosition;
-                    camera.updateViewMatrix();
-                }
+                glm::mat4 rotationMatX(1.0f);
+                rotationMatX = glm::rotate(rotationMatX, xAngle, camera.up);
+                position = (rotationMatX * (position - pivot)) + pivot;
 
-                buttonState = SDL_GetMouseState(&xPos, &yPos);
-                if( buttonState & SDL_BUTTON(SDL_BUTTON_RIGHT)) {
-                    // Update camera parameters
-
-                    float deltaY =  (float)(lastyPos - yPos) * 0.01f;
-                    glm::mat4 dollyTransform = glm::mat4(1.0f);
-                    dollyTransform = glm::translate(dollyTransform, normalize(camera.lookAt - camera.position) * deltaY);
-                    glm::vec3 newCameraPosition = dollyTransform * glm::vec4(camera.position, 1.0f);
-                    float newCameraFov = 2 * glm::atan(600.0f / (2 * deltaY)); // TODO Ask
-                    
-                    if(signbit(newCameraPosition.z) == signbit(camera.position.z)) {
-                        camera.position = newCameraPosition;
-                        camera.fov = newCameraFov; // TODO Ask
-                        }
-                }
+                glm::mat4 rotationMatY(1.0f);
+                rotationMatY = glm::rotate(rotationMatY, yAngle, camera.getRightVector());
+                glm::vec3 finalPosition = (rotationMatY * (position - pivot)) + pivot;
+                camera.position = finalPosition;
+                camera.updateViewMatrix();
+            }
 
-                lastxPos = xPos;
-                lastyPos = yPos;
+            buttonState = SDL_GetMouseState(&xPos, &yPos);
+            if( buttonState & SDL_BUTTON(SDL_BUTTON_RIGHT)) {
+                // Update camera parameters
 
-                view = camera.getViewMatrix();
+                float deltaY =  (float)(lastyPos - yPos) * 0.01f;
+                glm::mat4 dollyTransform = glm::mat4(1.0f);
+                dollyTransform = glm::translate(dollyTransform, normalize(camera.lookAt - camera.position) * deltaY);
+                glm::vec3 newCameraPosition = dollyTransform * glm::vec4(camera.position, 1.0f);
+                float newCameraFov = 2 * glm::atan(600.0f / (2 * deltaY)); // TODO Ask
                 
-                r.setUniform(program, "model", model);
-                r.setUniform(program, "view", view);
-                r.setUniform(program, "projection", projection);
-                r.setUniform(program, "lightPos", camera.position);
-                r.setUniform(program, "viewPos", camera.position);
-                r.setUniform(program, "lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
-
-                r.setupFilledFaces();
-                glm::vec3 orange(1.0f, 0.6f, 0.2f);
-                glm::vec3 white(1.0f, 1.0f, 1.0f);
-                r.setUniform(program, "ambientColor", 0.4f*orange);
-                r.setUniform(program, "diffuseColor", 0.9f*orange);
-                r.setUniform(program, "specularColor", 0.8f*white);
-                r.setUniform(program, "phongExponent", 100.f);
-                r.drawObject(object);
-
-                r.setupWireFrame();
-                glm::vec3 black(0.0f, 0.0f, 0.0f);
-                r.setUniform(program, "ambientColor", black);
-                r.setUniform(program, "diffuseColor", black);
-                r.setUniform(program, "specularColor", black);
-                r.setUniform(program, "phongExponent", 0.f);
-                r.drawObject(object);
-                r.show();
+                if(signbit(newCameraPosition.z) == signbit(camera.position.z)) {
+                    camera.position = newCameraPosition;
+                    camera.fov = newCameraFov; // TODO Ask
+                    }
             }
+
+            lastxPos = xPos;
+            lastyPos = yPos;
+
+            view = camera.getViewMatrix();
+            
+            r.setUniform(program, "model", model);
+            r.setUniform(program, "view", view);
+            r.setUniform(program, "projection", projection);
+            r.setUniform(program, "lightPos", camera.position);
+            r.setUniform(program, "viewPos", camera.position);
+            r.setUniform(program, "lightColor", glm::vec3(1.0f, 1.0f, 1.0f));
+
+            r.setupFilledFaces();
+            glm::vec3 orange(1.0f, 0.6f, 0.2f);
+            glm::vec3 white(1.0f, 1.0f, 1.0f);
+            r.setUniform(program, "ambientColor", 0.4f*orange);
+            r.setUniform(program, "diffuseColor", 0.9f*orange);
+            r.setUniform(program, "specularColor", 0.8f*white);
+            r.setUniform(program, "phongExponent", 100.f);
+            r.drawObject(object);
+
+            r.setupWireFrame();
+            glm::vec3 black(0.0f, 0.0f, 0.0f);
+            r.setUniform(program, "ambientColor", black);
+            r.setUniform(program, "diffuseColor", black);
+            r.setUniform(program, "specularColor", black);
+            r.setUniform(program, "phongExponent", 0.f);
+            r.drawObject(object);
+            r.show();
+            return true;
         }
 
     }
@@ -2,6 +2,8 @@
 #define VIEWER_HPP
 
 #include "hw.hpp"
+#include <mutex>
+#include <vector>
 
 namespace COL781 {
     namespace Viewer {
@@ -32,12 +34,45 @@ namespace COL781 {
             void setVertices(int n, const glm::vec3* vertices);
             void setNormals(int n, const glm::vec3* normals);
             void setTriangles(int n, const glm::ivec3* triangles);
+
+            // Uploads positions and normals together into one interleaved buffer, streamed in
+            // chunks. Cheaper than setVertices and setNormals for large meshes.
+            void setVertexData(int n, const glm::vec3* vertices, const glm::vec3* normals);
+
+            // Draws frames until the window is closed.
             void view();
+
+            // Draws one frame after uploading whatever was published since the last one.
+            // Returns false once the window has been closed.
+            bool frame();
+
+            // Hands new vertex data (and new triangles, if given) to the thread running view().
+            // Safe to call from any thread while view() runs: the data is copied into a staging
+            // buffer, and the next frame writes it into the existing interleaved GPU buffer.
+            // Publishing again before that frame replaces the staged data.
+            void publish(int nVertices, const glm::vec3* vertices, const glm::vec3* normals);
+            void publish(int nVertices, const glm::vec3* vertices, const glm::vec3* normals, int nTriangles, const glm::ivec3* triangles);
+
         private:
             COL781::OpenGL::Rasterizer r;
             COL781::OpenGL::ShaderProgram program;
             COL781::OpenGL::Object object;
             Camera camera;
+            glm::mat4 projection;
+
+            // Mouse state between frames
+            int lastxPos, lastyPos;
+            float deltaAngleX, deltaAngleY;
+
+            // Data published by other threads for the next frame, guarded by stagingMutex
+            std::mutex stagingMutex;
+            std::vector<glm::vec3> stagedVertices, stagedNormals;
+            std::vector<glm::ivec3> stagedTriangles;
+            bool verticesStaged = false, trianglesStaged = false;
+
+            // Buffers the frame uploads from, swapped with the staged ones so neither side reallocates
+            std::vector<glm::vec3> uploadVertices, uploadNormals;
+            std::vector<glm::ivec3> uploadTriangles;
         };
 
     }